@@ -5,10 +5,16 @@
 #include "devices/serial.h"
 #include "devices/timer.h"
 #include "threads/io.h"
+#include "threads/memstat.h"
+#include "threads/slab.h"
 #include "threads/thread.h"
 #ifdef USERPROG
 #include "userprog/exception.h"
 #endif
+#ifdef VM
+#include "vm/swap.h"
+#include "vm/vmstat.h"
+#endif
 #ifdef FILESYS
 #include "devices/block.h"
 #include "filesys/filesys.h"
@@ -135,7 +141,13 @@ print_stats (void)
 #endif
   console_print_stats ();
   kbd_print_stats ();
+  kmem_cache_print_stats ();
+  memstat_print_stats ();
 #ifdef USERPROG
   exception_print_stats ();
 #endif
+#ifdef VM
+  vmstat_print_stats ();
+  swap_print_stats ();
+#endif
 }
@@ -3,6 +3,8 @@
 #include <limits.h>
 #include <round.h>
 #include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
 #include "threads/malloc.h"
 #ifdef FILESYS
 #include "filesys/file.h"
@@ -23,11 +25,21 @@ typedef unsigned long elem_type;
 
 /* From the outside, a bitmap is an array of bits.  From the
    inside, it's an array of elem_type (defined above) that
-   simulates an array of bits. */
+   simulates an array of bits.
+
+   A second, smaller bitmap summarizes the first: its bit I is
+   set when element I has all of its bits set.  Searches for
+   unset bits, which is what allocators do, skip a whole summary
+   element's worth of full elements (1,024 bits) at a time, and
+   otherwise look at an element at a time rather than a bit at a
+   time.  Each change to an element updates its summary bit with
+   interrupts disabled, so that changing a single bit remains
+   atomic. */
 struct bitmap
   {
     size_t bit_cnt;     /* Number of bits. */
     elem_type *bits;    /* Elements that represent bits. */
+    elem_type *full;    /* Summary: which elements are full. */
   };
 
 /* Returns the index of the element that contains the bit
@@ -60,6 +72,14 @@ byte_cnt (size_t bit_cnt)
   return sizeof (elem_type) * elem_cnt (bit_cnt);
 }
 
+/* Returns the number of bytes required for the elements and the
+   summary of a bitmap of BIT_CNT bits. */
+static inline size_t
+storage_size (size_t bit_cnt)
+{
+  return byte_cnt (bit_cnt) + byte_cnt (elem_cnt (bit_cnt));
+}
+
 /* Returns a bit mask in which the bits actually used in the last
    element of B's bits are set to 1 and the rest are set to 0. */
 static inline elem_type
@@ -69,6 +89,54 @@ last_mask (const struct bitmap *b)
   return last_bits ? ((elem_type) 1 << last_bits) - 1 : (elem_type) -1;
 }
 
+/* Returns an elem_type with the CNT bits starting at bit OFS
+   turned on.  OFS + CNT must not exceed ELEM_BITS. */
+static inline elem_type
+range_mask (size_t ofs, size_t cnt) 
+{
+  elem_type mask = (cnt < ELEM_BITS
+                    ? ((elem_type) 1 << cnt) - 1
+                    : (elem_type) -1);
+  return mask << ofs;
+}
+
+/* Returns the number of bits set in W. */
+static inline size_t
+count_bits (elem_type w) 
+{
+  size_t cnt = 0;
+  for (; w != 0; w &= w - 1)
+    cnt++;
+  return cnt;
+}
+
+/* Sets the summary bit of B's element IDX according to whether
+   the element is full.  Must be called with interrupts off. */
+static inline void
+update_summary (struct bitmap *b, size_t idx) 
+{
+  elem_type full = (idx == elem_cnt (b->bit_cnt) - 1
+                    ? last_mask (b)
+                    : (elem_type) -1);
+  if (b->bits[idx] == full)
+    b->full[elem_idx (idx)] |= bit_mask (idx);
+  else
+    b->full[elem_idx (idx)] &= ~bit_mask (idx);
+}
+
+/* Sets the bits in MASK of B's element IDX to VALUE. */
+static inline void
+set_bits (struct bitmap *b, size_t idx, elem_type mask, bool value) 
+{
+  enum intr_level old_level = intr_disable ();
+  if (value)
+    b->bits[idx] |= mask;
+  else
+    b->bits[idx] &= ~mask;
+  update_summary (b, idx);
+  intr_set_level (old_level);
+}
+
 /* Creation and destruction. */
 
 /* Creates and returns a pointer to a newly allocated bitmap with room for
@@ -82,10 +150,11 @@ bitmap_create (size_t bit_cnt)
   if (b != NULL)
     {
       b->bit_cnt = bit_cnt;
-      b->bits = malloc (byte_cnt (bit_cnt));
+      b->bits = malloc (storage_size (bit_cnt));
       if (b->bits != NULL || bit_cnt == 0)
         {
-          bitmap_set_all (b, false);
+          b->full = b->bits + elem_cnt (bit_cnt);
+          memset (b->bits, 0, storage_size (bit_cnt));
           return b;
         }
       free (b);
@@ -105,7 +174,8 @@ bitmap_create_in_buf (size_t bit_cnt, void *block, size_t block_size UNUSED)
 
   b->bit_cnt = bit_cnt;
   b->bits = (elem_type *) (b + 1);
-  bitmap_set_all (b, false);
+  b->full = b->bits + elem_cnt (bit_cnt);
+  memset (b->bits, 0, storage_size (bit_cnt));
   return b;
 }
 
@@ -114,7 +184,7 @@ bitmap_create_in_buf (size_t bit_cnt, void *block, size_t block_size UNUSED)
 size_t
 bitmap_buf_size (size_t bit_cnt) 
 {
-  return sizeof (struct bitmap) + byte_cnt (bit_cnt);
+  return sizeof (struct bitmap) + storage_size (bit_cnt);
 }
 
 /* Destroys bitmap B, freeing its storage.
@@ -156,26 +226,14 @@ bitmap_set (struct bitmap *b, size_t idx, bool value)
 void
 bitmap_mark (struct bitmap *b, size_t bit_idx) 
 {
-  size_t idx = elem_idx (bit_idx);
-  elem_type mask = bit_mask (bit_idx);
-
-  /* This is equivalent to `b->bits[idx] |= mask' except that it
-     is guaranteed to be atomic on a uniprocessor machine.  See
-     the description of the OR instruction in [IA32-v2b]. */
-  asm ("orl %1, %0" : "=m" (b->bits[idx]) : "r" (mask) : "cc");
+  set_bits (b, elem_idx (bit_idx), bit_mask (bit_idx), true);
 }
 
 /* Atomically sets the bit numbered BIT_IDX in B to false. */
 void
 bitmap_reset (struct bitmap *b, size_t bit_idx) 
 {
-  size_t idx = elem_idx (bit_idx);
-  elem_type mask = bit_mask (bit_idx);
-
-  /* This is equivalent to `b->bits[idx] &= ~mask' except that it
-     is guaranteed to be atomic on a uniprocessor machine.  See
-     the description of the AND instruction in [IA32-v2a]. */
-  asm ("andl %1, %0" : "=m" (b->bits[idx]) : "r" (~mask) : "cc");
+  set_bits (b, elem_idx (bit_idx), bit_mask (bit_idx), false);
 }
 
 /* Atomically toggles the bit numbered IDX in B;
@@ -185,12 +243,10 @@ void
 bitmap_flip (struct bitmap *b, size_t bit_idx) 
 {
   size_t idx = elem_idx (bit_idx);
-  elem_type mask = bit_mask (bit_idx);
-
-  /* This is equivalent to `b->bits[idx] ^= mask' except that it
-     is guaranteed to be atomic on a uniprocessor machine.  See
-     the description of the XOR instruction in [IA32-v2b]. */
-  asm ("xorl %1, %0" : "=m" (b->bits[idx]) : "r" (mask) : "cc");
+  enum intr_level old_level = intr_disable ();
+  b->bits[idx] ^= bit_mask (bit_idx);
+  update_summary (b, idx);
+  intr_set_level (old_level);
 }
 
 /* Returns the value of the bit numbered IDX in B. */
@@ -213,18 +269,24 @@ bitmap_set_all (struct bitmap *b, bool value)
   bitmap_set_multiple (b, 0, bitmap_size (b), value);
 }
 
-/* Sets the CNT bits starting at START in B to VALUE. */
+/* Sets the CNT bits starting at START in B to VALUE.
+   Each element is set atomically, but not the group as a whole. */
 void
 bitmap_set_multiple (struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
-  size_t i;
+  size_t end = start + cnt;
   
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
-  for (i = 0; i < cnt; i++)
-    bitmap_set (b, start + i, value);
+  while (start < end)
+    {
+      size_t ofs = start % ELEM_BITS;
+      size_t n = ELEM_BITS - ofs < end - start ? ELEM_BITS - ofs : end - start;
+      set_bits (b, elem_idx (start), range_mask (ofs, n), value);
+      start += n;
+    }
 }
 
 /* Returns the number of bits in B between START and START + CNT,
@@ -232,17 +294,21 @@ bitmap_set_multiple (struct bitmap *b, size_t start, size_t cnt, bool value)
 size_t
 bitmap_count (const struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
-  size_t i, value_cnt;
+  size_t end = start + cnt;
+  size_t true_cnt = 0;
 
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
-  value_cnt = 0;
-  for (i = 0; i < cnt; i++)
-    if (bitmap_test (b, start + i) == value)
-      value_cnt++;
-  return value_cnt;
+  while (start < end)
+    {
+      size_t ofs = start % ELEM_BITS;
+      size_t n = ELEM_BITS - ofs < end - start ? ELEM_BITS - ofs : end - start;
+      true_cnt += count_bits (b->bits[elem_idx (start)] & range_mask (ofs, n));
+      start += n;
+    }
+  return value ? true_cnt : cnt - true_cnt;
 }
 
 /* Returns true if any bits in B between START and START + CNT,
@@ -250,15 +316,22 @@ bitmap_count (const struct bitmap *b, size_t start, size_t cnt, bool value)
 bool
 bitmap_contains (const struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
-  size_t i;
+  size_t end = start + cnt;
   
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
-  for (i = 0; i < cnt; i++)
-    if (bitmap_test (b, start + i) == value)
-      return true;
+  while (start < end)
+    {
+      size_t ofs = start % ELEM_BITS;
+      size_t n = ELEM_BITS - ofs < end - start ? ELEM_BITS - ofs : end - start;
+      elem_type mask = range_mask (ofs, n);
+      elem_type bits = b->bits[elem_idx (start)] & mask;
+      if (value ? bits != 0 : bits != mask)
+        return true;
+      start += n;
+    }
   return false;
 }
 
@@ -288,6 +361,53 @@ bitmap_all (const struct bitmap *b, size_t start, size_t cnt)
 
 /* Finding set or unset bits. */
 
+/* Returns the index of the first element of B at or after IDX
+   that is not full, or the number of elements if there is none. */
+static size_t
+next_nonfull (const struct bitmap *b, size_t idx) 
+{
+  size_t cnt = elem_cnt (b->bit_cnt);
+  size_t s = elem_idx (idx);
+  elem_type w;
+
+  if (idx >= cnt)
+    return cnt;
+  w = ~b->full[s] & ((elem_type) -1 << (idx % ELEM_BITS));
+  while (w == 0)
+    {
+      if (++s >= elem_cnt (cnt))
+        return cnt;
+      w = ~b->full[s];
+    }
+  idx = s * ELEM_BITS + __builtin_ctzl (w);
+  return idx < cnt ? idx : cnt;
+}
+
+/* Returns the index of the first bit in B between START and END,
+   exclusive, that is set to VALUE, or END if there is none. */
+static size_t
+find_next (const struct bitmap *b, size_t start, size_t end, bool value) 
+{
+  size_t idx = elem_idx (start);
+  elem_type w;
+
+  if (start >= end)
+    return end;
+  w = value ? b->bits[idx] : ~b->bits[idx];
+  w &= (elem_type) -1 << (start % ELEM_BITS);
+  while (w == 0)
+    {
+      idx++;
+      if (!value)
+        idx = next_nonfull (b, idx);
+      if (idx * ELEM_BITS >= end)
+        return end;
+      w = value ? b->bits[idx] : ~b->bits[idx];
+    }
+  start = idx * ELEM_BITS + __builtin_ctzl (w);
+  return start < end ? start : end;
+}
+
 /* Finds and returns the starting index of the first group of CNT
    consecutive bits in B at or after START that are all set to
    VALUE.
@@ -301,10 +421,22 @@ bitmap_scan (const struct bitmap *b, size_t start, size_t cnt, bool value)
   if (cnt <= b->bit_cnt) 
     {
       size_t last = b->bit_cnt - cnt;
-      size_t i;
-      for (i = start; i <= last; i++)
-        if (!bitmap_contains (b, i, cnt, !value))
-          return i; 
+      size_t i = start;
+      if (cnt == 0)
+        return start;
+      while (i <= last)
+        {
+          /* Find the start of a run of VALUE, then its end, but
+             looking no further than CNT bits in. */
+          size_t run_end;
+          i = find_next (b, i, last + 1, value);
+          if (i > last)
+            break;
+          run_end = find_next (b, i, i + cnt, !value);
+          if (run_end == i + cnt)
+            return i;
+          i = run_end;
+        }
     }
   return BITMAP_ERROR;
 }
@@ -344,8 +476,15 @@ bitmap_read (struct bitmap *b, struct file *file)
   if (b->bit_cnt > 0) 
     {
       off_t size = byte_cnt (b->bit_cnt);
+      enum intr_level old_level;
+      size_t i;
+
       success = file_read_at (file, b->bits, size, 0) == size;
       b->bits[elem_cnt (b->bit_cnt) - 1] &= last_mask (b);
+      old_level = intr_disable ();
+      for (i = 0; i < elem_cnt (b->bit_cnt); i++)
+        update_summary (b, i);
+      intr_set_level (old_level);
     }
   return success;
 }
@@ -28,7 +28,28 @@ enum
     SYS_MKDIR,                  /* Create a directory. */
     SYS_READDIR,                /* Reads a directory entry. */
     SYS_ISDIR,                  /* Tests if a fd represents a directory. */
-    SYS_INUMBER                 /* Returns the inode number for a fd. */
+    SYS_INUMBER,                /* Returns the inode number for a fd. */
+
+    /* Virtual memory extensions. */
+    SYS_SBRK,                   /* Move the program break. */
+    SYS_MMAP_FLAGS,             /* Map a file or anonymous memory. */
+    SYS_MADVISE,                /* Give a hint about memory usage. */
+    SYS_MLOCK,                  /* Keep pages resident. */
+    SYS_MUNLOCK,                /* Let locked pages be evicted again. */
+    SYS_EXEC_RSS,               /* Start a process with an RSS limit. */
+    SYS_MSYNC,                  /* Write back a memory mapped file. */
+    SYS_VMSTAT                  /* Read virtual memory statistics. */
   };
 
+/* Flags for mmap_flags(). */
+#define MAP_ANONYMOUS 0x1       /* Zero-filled memory, no file. */
+#define MAP_POPULATE 0x2        /* Read in the whole mapping now. */
+
+/* Advice for madvise(). */
+#define MADV_NORMAL 0           /* No particular access pattern. */
+#define MADV_RANDOM 1           /* Pages are accessed in random order. */
+#define MADV_SEQUENTIAL 2       /* Pages are accessed in ascending order. */
+#define MADV_WILLNEED 3         /* Pages will be accessed soon. */
+#define MADV_DONTNEED 4         /* Contents are no longer needed. */
+
 #endif /* lib/syscall-nr.h */
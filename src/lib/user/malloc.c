@@ -0,0 +1,419 @@
+#include <malloc.h>
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
+
+/* A size-class malloc() for user programs.
+
+   As in the kernel allocator, each request is rounded up to a
+   power of 2 and served by the "descriptor" for that size.
+   Blocks are carved out of one-page "arenas" whose header sits
+   at the start of the page, so free() finds a block's arena by
+   rounding its address down.
+
+   Each arena keeps its own free list, and each descriptor keeps
+   the arenas that still have free blocks.  An arena that becomes
+   entirely free goes back to a pool of heap pages, where any
+   size class can reuse it, unless it is the last arena of its
+   descriptor.  Heap pages are obtained from sbrk() a chunk at a
+   time, so most calls never enter the kernel.
+
+   Blocks too big for an arena get their own pages.  A single
+   page comes from the heap pool; anything larger is mapped with
+   anonymous mmap and unmapped again on free(), so large buffers
+   do not pin down heap memory.
+
+   User processes have a single thread, so no locking is
+   needed: the descriptors are the thread's cache. */
+
+#define PGSIZE 4096
+#define pg_ofs(P) ((uintptr_t) (P) & (PGSIZE - 1))
+#define pg_round_down(P) ((void *) ((uintptr_t) (P) & ~(PGSIZE - 1)))
+
+/* Number of pages requested from sbrk() at a time. */
+#define HEAP_CHUNK_PAGES 16
+
+/* Big blocks are mapped downwards from here, well clear of both
+   the heap and the stack. */
+#define MMAP_TOP ((uint8_t *) 0x80000000)
+
+/* Number of addresses tried before giving up on a big block. */
+#define MMAP_TRIES 16
+
+/* Descriptor. */
+struct desc
+  {
+    size_t block_size;          /* Size of each element in bytes. */
+    size_t blocks_per_arena;    /* Number of blocks in an arena. */
+    struct arena *partial;      /* Arenas with free blocks. */
+  };
+
+/* Magic number for detecting arena corruption. */
+#define ARENA_MAGIC 0x9a548eed
+
+/* Arena. */
+struct arena
+  {
+    unsigned magic;             /* Always set to ARENA_MAGIC. */
+    struct desc *desc;          /* Owning descriptor, null for big block. */
+    size_t free_cnt;            /* Free blocks; pages in big block. */
+    struct block *free_list;    /* Freed blocks in this arena. */
+    size_t unused_idx;          /* First block never handed out. */
+    mapid_t mapid;              /* Big block mapping, or MAP_FAILED. */
+    struct arena *prev;         /* Previous arena in descriptor's list. */
+    struct arena *next;         /* Next arena in descriptor's list. */
+  };
+
+/* Free block. */
+struct block
+  {
+    struct block *next;         /* Next free block in the arena. */
+  };
+
+/* Page in the free page pool. */
+struct pool_page
+  {
+    struct pool_page *next;
+  };
+
+/* Our set of descriptors. */
+static struct desc descs[8];    /* Descriptors. */
+static size_t desc_cnt;         /* Number of descriptors. */
+
+/* Heap pages. */
+static struct pool_page *free_pages; /* Pages given back by free(). */
+static uint8_t *heap_next;      /* Next never-used page from sbrk(). */
+static uint8_t *heap_end;       /* End of the pages from sbrk(). */
+
+/* Where the next big block is mapped. */
+static uint8_t *mmap_cursor = MMAP_TOP;
+
+static struct arena *block_to_arena (struct block *);
+static struct block *arena_to_block (struct arena *, size_t idx);
+
+/* Initializes the descriptors on first use. */
+static void
+malloc_init (void)
+{
+  size_t block_size;
+
+  for (block_size = 16; block_size < PGSIZE / 2; block_size *= 2)
+    {
+      struct desc *d = &descs[desc_cnt++];
+      ASSERT (desc_cnt <= sizeof descs / sizeof *descs);
+      d->block_size = block_size;
+      d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
+      d->partial = NULL;
+    }
+}
+
+/* Returns a page of heap memory, or a null pointer if the heap
+   cannot grow. */
+static void *
+get_page (void)
+{
+  if (free_pages != NULL)
+    {
+      struct pool_page *p = free_pages;
+      free_pages = p->next;
+      return p;
+    }
+
+  if (heap_next == heap_end)
+    {
+      /* Someone else may have moved the break, so align it. */
+      uint8_t *brk = sbrk (0);
+      size_t pad = ROUND_UP ((uintptr_t) brk, PGSIZE) - (uintptr_t) brk;
+      if (sbrk (pad + HEAP_CHUNK_PAGES * PGSIZE) == (void *) -1)
+        return NULL;
+      heap_next = brk + pad;
+      heap_end = heap_next + HEAP_CHUNK_PAGES * PGSIZE;
+    }
+
+  heap_next += PGSIZE;
+  return heap_next - PGSIZE;
+}
+
+/* Returns heap page P to the pool. */
+static void
+put_page (void *p)
+{
+  struct pool_page *page = p;
+  page->next = free_pages;
+  free_pages = page;
+}
+
+/* Maps PAGE_CNT zeroed pages and returns them, or a null pointer
+   if no room is found. */
+static struct arena *
+map_pages (size_t page_cnt)
+{
+  size_t size = page_cnt * PGSIZE;
+  int i;
+
+  for (i = 0; i < MMAP_TRIES; i++)
+    {
+      mapid_t mapid;
+
+      /* Skip over whatever is in the way, e.g. a file mapping. */
+      if (size > (uintptr_t) mmap_cursor - (uintptr_t) heap_end)
+        return NULL;
+      mmap_cursor -= size;
+      mapid = mmap_flags (-1, mmap_cursor, size, MAP_ANONYMOUS);
+      if (mapid != MAP_FAILED)
+        {
+          struct arena *a = (struct arena *) mmap_cursor;
+          a->mapid = mapid;
+          return a;
+        }
+    }
+  return NULL;
+}
+
+/* Adds A to the front of its descriptor's list. */
+static void
+push_partial (struct arena *a)
+{
+  struct desc *d = a->desc;
+  a->prev = NULL;
+  a->next = d->partial;
+  if (d->partial != NULL)
+    d->partial->prev = a;
+  d->partial = a;
+}
+
+/* Removes A from its descriptor's list. */
+static void
+remove_partial (struct arena *a)
+{
+  if (a->prev != NULL)
+    a->prev->next = a->next;
+  else
+    a->desc->partial = a->next;
+  if (a->next != NULL)
+    a->next->prev = a->prev;
+}
+
+/* Obtains and returns a new block of at least SIZE bytes.
+   Returns a null pointer if memory is not available. */
+void *
+malloc (size_t size)
+{
+  struct desc *d;
+  struct block *b;
+  struct arena *a;
+
+  /* A null pointer satisfies a request for 0 bytes. */
+  if (size == 0)
+    return NULL;
+
+  if (desc_cnt == 0)
+    malloc_init ();
+
+  /* Find the smallest descriptor that satisfies a SIZE-byte
+     request. */
+  for (d = descs; d < descs + desc_cnt; d++)
+    if (d->block_size >= size)
+      break;
+  if (d == descs + desc_cnt)
+    {
+      /* SIZE is too big for any descriptor.
+         Allocate enough pages to hold SIZE plus an arena. */
+      size_t page_cnt;
+
+      if (size > SIZE_MAX - sizeof *a - PGSIZE)
+        return NULL;
+      page_cnt = DIV_ROUND_UP (size + sizeof *a, PGSIZE);
+      if (page_cnt == 1)
+        {
+          a = get_page ();
+          if (a == NULL)
+            return NULL;
+          a->mapid = MAP_FAILED;
+        }
+      else
+        {
+          a = map_pages (page_cnt);
+          if (a == NULL)
+            return NULL;
+        }
+
+      /* Initialize the arena to indicate a big block of PAGE_CNT
+         pages, and return it. */
+      a->magic = ARENA_MAGIC;
+      a->desc = NULL;
+      a->free_cnt = page_cnt;
+      return a + 1;
+    }
+
+  /* If no arena has a free block, create a new one. */
+  a = d->partial;
+  if (a == NULL)
+    {
+      a = get_page ();
+      if (a == NULL)
+        return NULL;
+      a->magic = ARENA_MAGIC;
+      a->desc = d;
+      a->free_cnt = d->blocks_per_arena;
+      a->free_list = NULL;
+      a->unused_idx = 0;
+      a->mapid = MAP_FAILED;
+      push_partial (a);
+    }
+
+  /* Prefer recently freed blocks, which are likely still in the
+     cache, then carve a fresh one. */
+  if (a->free_list != NULL)
+    {
+      b = a->free_list;
+      a->free_list = b->next;
+    }
+  else
+    b = arena_to_block (a, a->unused_idx++);
+  if (--a->free_cnt == 0)
+    remove_partial (a);
+  return b;
+}
+
+/* Allocates and return A times B bytes initialized to zeroes.
+   Returns a null pointer if memory is not available. */
+void *
+calloc (size_t a, size_t b)
+{
+  void *p;
+  size_t size;
+
+  /* Calculate block size and make sure it fits in size_t. */
+  size = a * b;
+  if (b != 0 && size / b != a)
+    return NULL;
+
+  /* Allocate and zero memory. */
+  p = malloc (size);
+  if (p != NULL)
+    memset (p, 0, size);
+
+  return p;
+}
+
+/* Returns the number of bytes allocated for BLOCK. */
+static size_t
+block_size (void *block)
+{
+  struct block *b = block;
+  struct arena *a = block_to_arena (b);
+  struct desc *d = a->desc;
+
+  return d != NULL ? d->block_size : PGSIZE * a->free_cnt - pg_ofs (block);
+}
+
+/* Attempts to resize OLD_BLOCK to NEW_SIZE bytes, possibly
+   moving it in the process.
+   If successful, returns the new block; on failure, returns a
+   null pointer.
+   A call with null OLD_BLOCK is equivalent to malloc(NEW_SIZE).
+   A call with zero NEW_SIZE is equivalent to free(OLD_BLOCK). */
+void *
+realloc (void *old_block, size_t new_size)
+{
+  if (new_size == 0)
+    {
+      free (old_block);
+      return NULL;
+    }
+  else if (old_block != NULL && new_size <= block_size (old_block))
+    return old_block;
+  else
+    {
+      void *new_block = malloc (new_size);
+      if (old_block != NULL && new_block != NULL)
+        {
+          memcpy (new_block, old_block, block_size (old_block));
+          free (old_block);
+        }
+      return new_block;
+    }
+}
+
+/* Frees block P, which must have been previously allocated with
+   malloc(), calloc(), or realloc(). */
+void
+free (void *p)
+{
+  if (p != NULL)
+    {
+      struct block *b = p;
+      struct arena *a = block_to_arena (b);
+      struct desc *d = a->desc;
+
+      if (d != NULL)
+        {
+          /* It's a normal block.  We handle it here. */
+
+#ifndef NDEBUG
+          /* Clear the block to help detect use-after-free bugs. */
+          memset (b, 0xcc, d->block_size);
+#endif
+
+          /* Add block to its arena's free list. */
+          b->next = a->free_list;
+          a->free_list = b;
+          if (a->free_cnt++ == 0)
+            push_partial (a);
+
+          /* If the arena is now entirely unused, give its page back,
+             but keep one around so that a block bouncing between
+             malloc() and free() does not cycle pages. */
+          if (a->free_cnt >= d->blocks_per_arena
+              && (a->prev != NULL || a->next != NULL))
+            {
+              ASSERT (a->free_cnt == d->blocks_per_arena);
+              remove_partial (a);
+              put_page (a);
+            }
+        }
+      else if (a->mapid != MAP_FAILED)
+        {
+          /* It's a big block.  Unmap its pages. */
+          munmap (a->mapid);
+        }
+      else
+        {
+          /* It's a one-page big block from the heap. */
+          put_page (a);
+        }
+    }
+}
+
+/* Returns the arena that block B is inside. */
+static struct arena *
+block_to_arena (struct block *b)
+{
+  struct arena *a = pg_round_down (b);
+
+  /* Check that the arena is valid. */
+  ASSERT (a != NULL);
+  ASSERT (a->magic == ARENA_MAGIC);
+
+  /* Check that the block is properly aligned for the arena. */
+  ASSERT (a->desc == NULL
+          || (pg_ofs (b) - sizeof *a) % a->desc->block_size == 0);
+  ASSERT (a->desc != NULL || pg_ofs (b) == sizeof *a);
+
+  return a;
+}
+
+/* Returns the IDX'th block within arena A. */
+static struct block *
+arena_to_block (struct arena *a, size_t idx)
+{
+  ASSERT (a != NULL);
+  ASSERT (a->magic == ARENA_MAGIC);
+  ASSERT (idx < a->desc->blocks_per_arena);
+  return (struct block *) ((uint8_t *) a
+                           + sizeof *a
+                           + idx * a->desc->block_size);
+}
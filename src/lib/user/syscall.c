@@ -61,6 +61,25 @@
           retval;                                               \
         })
 
+/* Invokes syscall NUMBER, passing arguments ARG0, ARG1, ARG2,
+   and ARG3, and returns the return value as an `int'. */
+#define syscall4(NUMBER, ARG0, ARG1, ARG2, ARG3)                \
+        ({                                                      \
+          int retval;                                           \
+          asm volatile                                          \
+            ("pushl %[arg3]; pushl %[arg2]; pushl %[arg1]; "    \
+             "pushl %[arg0]; "                                  \
+             "pushl %[number]; int $0x30; addl $20, %%esp"      \
+               : "=a" (retval)                                  \
+               : [number] "i" (NUMBER),                         \
+                 [arg0] "r" (ARG0),                             \
+                 [arg1] "r" (ARG1),                             \
+                 [arg2] "r" (ARG2),                             \
+                 [arg3] "r" (ARG3)                              \
+               : "memory");                                     \
+          retval;                                               \
+        })
+
 void
 halt (void) 
 {
@@ -182,3 +201,51 @@ inumber (int fd)
 {
   return syscall1 (SYS_INUMBER, fd);
 }
+
+void *
+sbrk (intptr_t increment)
+{
+  return (void *) syscall1 (SYS_SBRK, increment);
+}
+
+mapid_t
+mmap_flags (int fd, void *addr, size_t length, int flags)
+{
+  return syscall4 (SYS_MMAP_FLAGS, fd, addr, length, flags);
+}
+
+int
+madvise (void *addr, size_t length, int advice)
+{
+  return syscall3 (SYS_MADVISE, addr, length, advice);
+}
+
+int
+mlock (const void *addr, size_t length)
+{
+  return syscall2 (SYS_MLOCK, addr, length);
+}
+
+int
+munlock (const void *addr, size_t length)
+{
+  return syscall2 (SYS_MUNLOCK, addr, length);
+}
+
+pid_t
+exec_rss (const char *cmd_line, size_t max_pages)
+{
+  return (pid_t) syscall2 (SYS_EXEC_RSS, cmd_line, max_pages);
+}
+
+int
+msync (mapid_t mapping)
+{
+  return syscall1 (SYS_MSYNC, mapping);
+}
+
+int
+vmstat (struct vmstat *stats)
+{
+  return syscall1 (SYS_VMSTAT, stats);
+}
@@ -3,6 +3,9 @@
 
 #include <stdbool.h>
 #include <debug.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <syscall-nr.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -12,6 +15,28 @@ typedef int pid_t;
 typedef int mapid_t;
 #define MAP_FAILED ((mapid_t) -1)
 
+/* Virtual memory statistics filled in by vmstat().  Counts are since
+   boot and cover all processes. */
+struct vmstat
+  {
+    long long minor_faults;     /* Faults served without disk reads. */
+    long long major_faults;     /* Faults that read from file or swap. */
+    long long file_fills;       /* Pages read from a file. */
+    long long swap_fills;       /* Pages read back from swap. */
+    long long zero_fills;       /* Pages filled with zeros. */
+    long long cache_hits;       /* File pages found in the page cache. */
+    long long evict_clean;      /* Evicted pages that were just dropped. */
+    long long evict_file;       /* Evicted pages owed to their file. */
+    long long evict_swap;       /* Evicted pages written to swap. */
+    long long evict_async;      /* Dirty victims left to the writer. */
+    long long writebacks;       /* Dirty pages written to their file. */
+    long long clock_scans;      /* Frames looked at by the clock hand. */
+    long long stack_growths;    /* Pages added to user stacks. */
+    long long oom_kills;        /* Processes killed for lack of memory. */
+    long long swap_used;        /* Swap slots in use now. */
+    long long swap_total;       /* Swap slots on all devices. */
+  };
+
 /* Maximum characters in a filename written by readdir(). */
 #define READDIR_MAX_LEN 14
 
@@ -38,6 +63,16 @@ void close (int fd);
 mapid_t mmap (int fd, void *addr);
 void munmap (mapid_t);
 
+/* Virtual memory extensions. */
+void *sbrk (intptr_t increment);
+mapid_t mmap_flags (int fd, void *addr, size_t length, int flags);
+int madvise (void *addr, size_t length, int advice);
+int mlock (const void *addr, size_t length);
+int munlock (const void *addr, size_t length);
+pid_t exec_rss (const char *cmd_line, size_t max_pages);
+int msync (mapid_t mapping);
+int vmstat (struct vmstat *);
+
 /* Project 4 only. */
 bool chdir (const char *dir);
 bool mkdir (const char *dir);
@@ -0,0 +1,117 @@
+/* Checks bitmap_scan(), which skips full elements with the help
+   of a summary bitmap, against a plain bit-by-bit search.  Then
+   times both on a nearly full bitmap the size of a 1 GB swap
+   device.
+
+   The timings depend on the simulator, so bitmap-scan.ck ignores
+   them. */
+
+#include <bitmap.h>
+#include <inttypes.h>
+#include <random.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "devices/timer.h"
+
+/* One bit per page of a 1 GB swap device. */
+#define BIT_CNT 262144
+
+/* Random updates made while checking, each followed by a scan. */
+#define CHECK_ROUNDS 2000
+
+/* Scans timed for each method. */
+#define WORD_SCANS 10000
+#define BIT_SCANS 20
+
+/* Returns the index of the first run of CNT bits set to VALUE at
+   or after START in B, testing one bit at a time like
+   bitmap_scan() did before it kept a summary. */
+static size_t
+naive_scan (const struct bitmap *b, size_t start, size_t cnt, bool value)
+{
+  size_t bit_cnt = bitmap_size (b);
+  size_t i, j;
+
+  for (i = start; i + cnt <= bit_cnt; i++)
+    {
+      for (j = 0; j < cnt; j++)
+        if (bitmap_test (b, i + j) != value)
+          break;
+      if (j == cnt)
+        return i;
+    }
+  return BITMAP_ERROR;
+}
+
+/* Makes random changes to B and checks bitmap_scan() against
+   naive_scan() after each. */
+static void
+check_scans (struct bitmap *b)
+{
+  int round;
+
+  random_init (0);
+  bitmap_set_all (b, true);
+  for (round = 0; round < CHECK_ROUNDS; round++)
+    {
+      size_t start = random_ulong () % BIT_CNT;
+      size_t cnt = random_ulong () % 70;
+      bool value = random_ulong () % 2;
+      size_t scan_start, scan_cnt, got, expected;
+
+      if (cnt > BIT_CNT - start)
+        cnt = BIT_CNT - start;
+      bitmap_set_multiple (b, start, cnt, random_ulong () % 8 == 0);
+
+      scan_start = random_ulong () % BIT_CNT;
+      scan_cnt = 1 + random_ulong () % 40;
+      got = bitmap_scan (b, scan_start, scan_cnt, value);
+      expected = naive_scan (b, scan_start, scan_cnt, value);
+      if (got != expected)
+        fail ("scan for %zu %s bits from %zu found %zu, not %zu",
+              scan_cnt, value ? "set" : "clear", scan_start, got, expected);
+      if (bitmap_count (b, 0, BIT_CNT, true)
+          + bitmap_count (b, 0, BIT_CNT, false) != BIT_CNT)
+        fail ("set and clear bit counts do not add up");
+    }
+  msg ("word-wise and bit-wise scans agree");
+}
+
+/* Times scans for a clear bit in B once all but a few bits near
+   its end are set, the worst case for swap slot allocation. */
+static void
+time_scans (struct bitmap *b)
+{
+  int64_t start;
+  int i;
+
+  bitmap_set_all (b, true);
+  for (i = 0; i < 8; i++)
+    bitmap_reset (b, BIT_CNT - 1 - i * 97);
+
+  start = timer_ticks ();
+  for (i = 0; i < WORD_SCANS; i++)
+    if (bitmap_scan (b, 0, 1, false) == BITMAP_ERROR)
+      fail ("word-wise scan found no clear bit");
+  msg ("%d word-wise scans: %"PRId64" ticks",
+       WORD_SCANS, timer_elapsed (start));
+
+  start = timer_ticks ();
+  for (i = 0; i < BIT_SCANS; i++)
+    if (naive_scan (b, 0, 1, false) == BITMAP_ERROR)
+      fail ("bit-wise scan found no clear bit");
+  msg ("%d bit-wise scans: %"PRId64" ticks",
+       BIT_SCANS, timer_elapsed (start));
+}
+
+void
+test_bitmap_scan (void)
+{
+  struct bitmap *b = bitmap_create (BIT_CNT);
+
+  if (b == NULL)
+    fail ("couldn't allocate bitmap");
+  check_scans (b);
+  time_scans (b);
+  bitmap_destroy (b);
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = grep (!/ ticks$/, @output);
+compare_output ("run", \@output, [<<'EOF']);
+(bitmap-scan) begin
+(bitmap-scan) word-wise and bit-wise scans agree
+(bitmap-scan) end
+EOF
+pass;
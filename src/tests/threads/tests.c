@@ -18,6 +18,7 @@ static const struct test tests[] =
     {"alarm-negative", test_alarm_negative},
     {"producer-consumer", test_producer_consumer},
     {"narrow-bridge", test_narrow_bridge},
+    {"bitmap-scan", test_bitmap_scan},
   };
 
 static const char *test_name;
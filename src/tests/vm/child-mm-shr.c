@@ -0,0 +1,22 @@
+/* Child process of mmap-shared.
+   Maps the file its parent has mapped, checks for the byte the
+   parent wrote through its own mapping, and writes to the first
+   half of the page. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ACTUAL ((char *) 0x10000000)
+
+void
+test_main (void)
+{
+  int handle;
+
+  CHECK ((handle = open ("data")) > 1, "open \"data\"");
+  CHECK (mmap (handle, ACTUAL) != MAP_FAILED, "mmap \"data\"");
+  CHECK (ACTUAL[4095] == 'p', "saw parent's write");
+  memset (ACTUAL, 'b', 2048);
+}
@@ -0,0 +1,21 @@
+/* Child process of oom-kill.
+   Grows the heap by 64 MB, which the kill OOM policy allows, and
+   writes to every page of it until it is killed. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define HUGE (64 * 1024 * 1024)
+
+void
+test_main (void)
+{
+  char *p;
+  size_t i;
+
+  CHECK ((p = sbrk (HUGE)) != (void *) -1, "sbrk 64 MB");
+  for (i = 0; i < HUGE; i += 4096)
+    p[i] = 1;
+  fail ("wrote 64 MB without being killed");
+}
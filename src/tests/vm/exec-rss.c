@@ -0,0 +1,23 @@
+/* Runs child-linear, which works through 1 MB of memory, with
+   exec_rss() limiting it to 32 resident pages.  The child must
+   still succeed, and since memory is otherwise plentiful, any
+   pages read back from swap meanwhile are its own. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  struct vmstat before, after;
+  pid_t child;
+
+  vmstat (&before);
+  CHECK ((child = exec_rss ("child-linear", 32)) != -1,
+         "exec_rss \"child-linear\" with 32 pages");
+  CHECK (wait (child) == 0x42, "wait for child");
+  vmstat (&after);
+  CHECK (after.swap_fills > before.swap_fills,
+         "child paged against its own limit");
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(exec-rss) begin
+(exec-rss) exec_rss "child-linear" with 32 pages
+(exec-rss) wait for child
+(exec-rss) child paged against its own limit
+(exec-rss) end
+EOF
+pass;
@@ -0,0 +1,63 @@
+/* Gives each madvise() hint for a file mapping and for anonymous
+   memory, checking that the hints never change what the memory
+   reads, except for MADV_DONTNEED, which makes anonymous memory
+   read as zeros again.  Also checks that bad ranges are
+   refused. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ACTUAL ((char *) 0x10000000)
+#define ANON ((char *) 0x20000000)
+#define PAGE_CNT 16
+#define SIZE (PAGE_CNT * 4096)
+
+static char buf[SIZE];
+
+void
+test_main (void)
+{
+  int handle;
+  mapid_t map, anon;
+  size_t i;
+
+  for (i = 0; i < SIZE; i++)
+    buf[i] = i * 7 / 4096 + i;
+  CHECK (create ("data", SIZE), "create \"data\"");
+  CHECK ((handle = open ("data")) > 1, "open \"data\"");
+  CHECK (write (handle, buf, SIZE) == SIZE, "write \"data\"");
+  CHECK ((map = mmap (handle, ACTUAL)) != MAP_FAILED, "mmap \"data\"");
+
+  CHECK (madvise (ACTUAL, SIZE, MADV_SEQUENTIAL) == 0, "MADV_SEQUENTIAL");
+  CHECK (madvise (ACTUAL, SIZE, MADV_WILLNEED) == 0, "MADV_WILLNEED");
+  if (memcmp (ACTUAL, buf, SIZE))
+    fail ("mapping read bad data after MADV_SEQUENTIAL");
+  CHECK (madvise (ACTUAL, SIZE, MADV_RANDOM) == 0, "MADV_RANDOM");
+  for (i = 0; i < PAGE_CNT; i++)
+    {
+      size_t page = i * 5 % PAGE_CNT;
+      if (memcmp (ACTUAL + page * 4096, buf + page * 4096, 4096))
+        fail ("page %zu of mapping read bad data after MADV_RANDOM", page);
+    }
+  CHECK (madvise (ACTUAL, SIZE, MADV_NORMAL) == 0, "MADV_NORMAL");
+  munmap (map);
+  close (handle);
+
+  CHECK ((anon = mmap_flags (-1, ANON, SIZE, MAP_ANONYMOUS)) != MAP_FAILED,
+         "mmap anonymous");
+  memset (ANON, 0x5a, SIZE);
+  CHECK (madvise (ANON, SIZE / 2, MADV_DONTNEED) == 0, "MADV_DONTNEED");
+  for (i = 0; i < SIZE; i++)
+    if (ANON[i] != (i < SIZE / 2 ? 0 : 0x5a))
+      fail ("byte %zu of anonymous mapping has value %02hhx after "
+            "MADV_DONTNEED", i, ANON[i]);
+
+  CHECK (madvise (ANON + 1, 4096, MADV_NORMAL) == -1,
+         "MADV_NORMAL on misaligned address");
+  CHECK (madvise (ANON, SIZE + 4096, MADV_WILLNEED) == -1,
+         "MADV_WILLNEED past end of mapping");
+  CHECK (madvise (ANON, 4096, 1234) == -1, "unknown advice");
+  munmap (anon);
+}
@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(madvise-hints) begin
+(madvise-hints) create "data"
+(madvise-hints) open "data"
+(madvise-hints) write "data"
+(madvise-hints) mmap "data"
+(madvise-hints) MADV_SEQUENTIAL
+(madvise-hints) MADV_WILLNEED
+(madvise-hints) MADV_RANDOM
+(madvise-hints) MADV_NORMAL
+(madvise-hints) mmap anonymous
+(madvise-hints) MADV_DONTNEED
+(madvise-hints) MADV_NORMAL on misaligned address
+(madvise-hints) MADV_WILLNEED past end of mapping
+(madvise-hints) unknown advice
+(madvise-hints) end
+EOF
+pass;
@@ -0,0 +1,111 @@
+/* Allocates blocks of many sizes with malloc(), calloc() and
+   realloc(), from a few bytes to several pages, frees them in
+   random order while allocating more, and checks that no block
+   ever overlaps another or loses its contents. */
+
+#include <malloc.h>
+#include <random.h>
+#include <string.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define BLOCK_CNT 256
+#define ROUNDS 2000
+
+static unsigned char *blocks[BLOCK_CNT];
+static size_t sizes[BLOCK_CNT];
+
+/* Returns a random size, mostly small but sometimes several
+   pages. */
+static size_t
+random_size (void)
+{
+  switch (random_ulong () % 8)
+    {
+    case 0:
+      return 4096 + random_ulong () % (5 * 4096);
+    case 1:
+    case 2:
+      return 1 + random_ulong () % 2048;
+    default:
+      return 1 + random_ulong () % 64;
+    }
+}
+
+/* Fills block I with bytes derived from its index. */
+static void
+fill (size_t i)
+{
+  memset (blocks[i], i + 1, sizes[i]);
+}
+
+/* Checks that block I still holds the bytes fill() wrote. */
+static void
+check (size_t i)
+{
+  size_t j;
+
+  for (j = 0; j < sizes[i]; j++)
+    if (blocks[i][j] != (unsigned char) (i + 1))
+      fail ("byte %zu of %zu-byte block %zu changed", j, sizes[i], i);
+}
+
+void
+test_main (void)
+{
+  size_t i;
+  int round;
+
+  random_init (0);
+  for (round = 0; round < ROUNDS; round++)
+    {
+      i = random_ulong () % BLOCK_CNT;
+      if (blocks[i] != NULL)
+        {
+          check (i);
+          if (random_ulong () % 2)
+            {
+              free (blocks[i]);
+              blocks[i] = NULL;
+              continue;
+            }
+
+          /* Grow or shrink, keeping the common prefix. */
+          size_t old_size = sizes[i];
+          sizes[i] = random_size ();
+          blocks[i] = realloc (blocks[i], sizes[i]);
+          if (blocks[i] == NULL)
+            fail ("realloc to %zu bytes failed", sizes[i]);
+          for (size_t j = 0; j < old_size && j < sizes[i]; j++)
+            if (blocks[i][j] != (unsigned char) (i + 1))
+              fail ("realloc lost byte %zu of block %zu", j, i);
+        }
+      else if (random_ulong () % 4 == 0)
+        {
+          sizes[i] = random_size ();
+          blocks[i] = calloc (1, sizes[i]);
+          if (blocks[i] == NULL)
+            fail ("calloc of %zu bytes failed", sizes[i]);
+          for (size_t j = 0; j < sizes[i]; j++)
+            if (blocks[i][j] != 0)
+              fail ("byte %zu of calloc'd block != 0", j);
+        }
+      else
+        {
+          sizes[i] = random_size ();
+          blocks[i] = malloc (sizes[i]);
+          if (blocks[i] == NULL)
+            fail ("malloc of %zu bytes failed", sizes[i]);
+        }
+      fill (i);
+    }
+  msg ("%d rounds of allocation passed", ROUNDS);
+
+  for (i = 0; i < BLOCK_CNT; i++)
+    if (blocks[i] != NULL)
+      {
+        check (i);
+        free (blocks[i]);
+      }
+  msg ("freed all blocks");
+}
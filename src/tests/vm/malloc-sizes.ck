@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(malloc-sizes) begin
+(malloc-sizes) 2000 rounds of allocation passed
+(malloc-sizes) freed all blocks
+(malloc-sizes) end
+EOF
+pass;
@@ -0,0 +1,24 @@
+/* Opens files and runs a child process, all of which allocate
+   kernel memory from malloc(), the page allocator and object
+   caches, with the -memstat option.  memstat-exec.ck checks the
+   per call site usage printed at shutdown. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  int handles[8];
+  size_t i;
+
+  CHECK (create ("data", 0), "create \"data\"");
+  for (i = 0; i < 8; i++)
+    if ((handles[i] = open ("data")) < 2)
+      fail ("open \"data\" failed");
+  for (i = 0; i < 8; i++)
+    close (handles[i]);
+  msg ("opened and closed \"data\" 8 times");
+  CHECK (wait (exec ("child-linear")) == 0x42, "run \"child-linear\"");
+}
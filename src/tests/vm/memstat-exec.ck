@@ -0,0 +1,30 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(memstat-exec) begin
+(memstat-exec) create "data"
+(memstat-exec) opened and closed "data" 8 times
+(memstat-exec) run "child-linear"
+(memstat-exec) end
+EOF
+my (@output) = read_text_file ("$test.output");
+my ($total) = grep (/^Kernel memory: /, @output);
+fail "missing kernel memory statistics at shutdown\n" if !defined $total;
+my ($malloc, $malloc_peak, $palloc, $palloc_peak, $slab, $slab_peak)
+  = $total =~ /malloc\ (\d+)\ bytes\ \(peak\ (\d+)\),
+                \ palloc\ (\d+)\ bytes\ \(peak\ (\d+)\),
+                \ slab\ (\d+)\ bytes\ \(peak\ (\d+)\)/x
+  or fail "bad kernel memory statistics line: $total\n";
+fail "peak usage below current usage\n"
+  if $malloc_peak < $malloc || $palloc_peak < $palloc || $slab_peak < $slab;
+my (@sites) = grep (/^  (0x[0-9a-f]+|0) (malloc|palloc|slab|other): \d+ live/,
+                    @output);
+fail "no allocation sites reported\n" if !@sites;
+fail "no palloc allocation sites reported\n"
+  if !grep (/ palloc: /, @sites);
+fail "no object cache allocation sites reported\n"
+  if !grep (/ slab: /, @sites);
+pass;
@@ -0,0 +1,48 @@
+/* Locks a buffer with mlock(), then writes through far more
+   memory than the kernel gives user pages, which it is run with
+   only 128 of.  Reading the locked buffer afterward must not
+   fault anything in from disk.  Also checks the limit on locked
+   pages and that unlocked memory can be locked again. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define LOCKED_SIZE (16 * 4096)
+#define CHURN_SIZE (1024 * 1024)
+
+static char locked[LOCKED_SIZE];
+static char churn[CHURN_SIZE];
+
+void
+test_main (void)
+{
+  struct vmstat before, after;
+  size_t i;
+
+  memset (locked, 0xa5, LOCKED_SIZE);
+  CHECK (mlock (locked, LOCKED_SIZE) == 0, "mlock 16 pages");
+
+  msg ("write 1 MB");
+  for (i = 0; i < CHURN_SIZE; i += 4096)
+    churn[i] = i / 4096;
+
+  vmstat (&before);
+  for (i = 0; i < LOCKED_SIZE; i++)
+    if (locked[i] != (char) 0xa5)
+      fail ("byte %zu of locked buffer changed", i);
+  vmstat (&after);
+  CHECK (after.major_faults == before.major_faults,
+         "locked buffer was still resident");
+
+  CHECK (mlock (churn, CHURN_SIZE) == -1, "mlock 256 pages fails");
+  CHECK (munlock (locked, LOCKED_SIZE) == 0, "munlock 16 pages");
+  CHECK (mlock (churn, 64 * 4096) == 0, "mlock 64 other pages");
+  CHECK (munlock (churn, 64 * 4096) == 0, "munlock 64 pages");
+
+  msg ("read 1 MB");
+  for (i = 0; i < CHURN_SIZE; i += 4096)
+    if (churn[i] != (char) (i / 4096))
+      fail ("byte %zu of churned buffer changed", i);
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mlock-resident) begin
+(mlock-resident) mlock 16 pages
+(mlock-resident) write 1 MB
+(mlock-resident) locked buffer was still resident
+(mlock-resident) mlock 256 pages fails
+(mlock-resident) munlock 16 pages
+(mlock-resident) mlock 64 other pages
+(mlock-resident) munlock 64 pages
+(mlock-resident) read 1 MB
+(mlock-resident) end
+EOF
+pass;
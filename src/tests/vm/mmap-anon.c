@@ -0,0 +1,47 @@
+/* Maps anonymous memory with mmap_flags(), checks that it reads
+   as zeros and keeps what is written to it, and that mapping the
+   same range again after munmap() gives fresh zeroed pages. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ACTUAL ((char *) 0x10000000)
+#define SIZE (8 * 4096 + 1)
+
+static void
+check_zeros (void)
+{
+  size_t i;
+
+  for (i = 0; i < SIZE; i++)
+    if (ACTUAL[i] != 0)
+      fail ("byte %zu of anonymous mapping != 0", i);
+}
+
+void
+test_main (void)
+{
+  mapid_t map;
+  size_t i;
+
+  CHECK ((map = mmap_flags (-1, ACTUAL, SIZE, MAP_ANONYMOUS)) != MAP_FAILED,
+         "mmap anonymous");
+  msg ("check mapping is zeroed");
+  check_zeros ();
+  for (i = 0; i < SIZE; i++)
+    ACTUAL[i] = i % 13 + 1;
+  for (i = 0; i < SIZE; i++)
+    if (ACTUAL[i] != (char) (i % 13 + 1))
+      fail ("byte %zu of anonymous mapping changed", i);
+  CHECK (mmap_flags (-1, ACTUAL + 4096, 4096, MAP_ANONYMOUS) == MAP_FAILED,
+         "try to map over the mapping");
+  munmap (map);
+
+  CHECK ((map = mmap_flags (-1, ACTUAL, SIZE, MAP_ANONYMOUS)) != MAP_FAILED,
+         "mmap anonymous again");
+  msg ("check new mapping is zeroed");
+  check_zeros ();
+  munmap (map);
+}
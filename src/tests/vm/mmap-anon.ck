@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mmap-anon) begin
+(mmap-anon) mmap anonymous
+(mmap-anon) check mapping is zeroed
+(mmap-anon) try to map over the mapping
+(mmap-anon) mmap anonymous again
+(mmap-anon) check new mapping is zeroed
+(mmap-anon) end
+EOF
+pass;
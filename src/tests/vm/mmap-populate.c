@@ -0,0 +1,54 @@
+/* Maps a file and anonymous memory with MAP_POPULATE and checks
+   that reading them afterward takes no page faults. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ACTUAL ((char *) 0x10000000)
+#define ANON ((char *) 0x20000000)
+#define SIZE (16 * 4096)
+
+static char buf[SIZE];
+
+/* Returns the number of page faults taken so far. */
+static long long
+fault_cnt (void)
+{
+  struct vmstat stats;
+
+  vmstat (&stats);
+  return stats.minor_faults + stats.major_faults;
+}
+
+void
+test_main (void)
+{
+  int handle;
+  mapid_t map, anon;
+  long long faults;
+  size_t i;
+
+  for (i = 0; i < SIZE; i++)
+    buf[i] = i % 97;
+  CHECK (create ("data", SIZE), "create \"data\"");
+  CHECK ((handle = open ("data")) > 1, "open \"data\"");
+  CHECK (write (handle, buf, SIZE) == SIZE, "write \"data\"");
+  CHECK ((map = mmap_flags (handle, ACTUAL, SIZE, MAP_POPULATE))
+         != MAP_FAILED, "mmap \"data\" with MAP_POPULATE");
+  CHECK ((anon = mmap_flags (-1, ANON, SIZE, MAP_ANONYMOUS | MAP_POPULATE))
+         != MAP_FAILED, "mmap anonymous with MAP_POPULATE");
+
+  faults = fault_cnt ();
+  if (memcmp (ACTUAL, buf, SIZE))
+    fail ("mapping of \"data\" read bad data");
+  for (i = 0; i < SIZE; i++)
+    if (ANON[i] != 0)
+      fail ("byte %zu of anonymous mapping != 0", i);
+  CHECK (fault_cnt () == faults, "read both mappings without faults");
+
+  munmap (anon);
+  munmap (map);
+  close (handle);
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mmap-populate) begin
+(mmap-populate) create "data"
+(mmap-populate) open "data"
+(mmap-populate) write "data"
+(mmap-populate) mmap "data" with MAP_POPULATE
+(mmap-populate) mmap anonymous with MAP_POPULATE
+(mmap-populate) read both mappings without faults
+(mmap-populate) end
+EOF
+pass;
@@ -0,0 +1,45 @@
+/* Maps a file and writes a byte to it through the mapping, then
+   runs child-mm-shr, which maps the same file, checks that it
+   sees that byte, and writes to the first half of the page.
+   Neither write reaches the file before the other process looks
+   for it, so both are only seen if the processes share the
+   page. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ACTUAL ((char *) 0x10000000)
+
+void
+test_main (void)
+{
+  char buf[4096];
+  int handle;
+  mapid_t map;
+  pid_t child;
+  size_t i;
+
+  memset (buf, 'a', sizeof buf);
+  CHECK (create ("data", sizeof buf), "create \"data\"");
+  CHECK ((handle = open ("data")) > 1, "open \"data\"");
+  CHECK (write (handle, buf, sizeof buf) == sizeof buf, "write \"data\"");
+  CHECK ((map = mmap (handle, ACTUAL)) != MAP_FAILED, "mmap \"data\"");
+  ACTUAL[sizeof buf - 1] = 'p';
+
+  CHECK ((child = exec ("child-mm-shr")) != -1, "exec \"child-mm-shr\"");
+  CHECK (wait (child) == 0, "wait for child (should return 0)");
+
+  for (i = 0; i < sizeof buf; i++)
+    {
+      char expected = (i < sizeof buf / 2 ? 'b'
+                       : i < sizeof buf - 1 ? 'a' : 'p');
+      if (ACTUAL[i] != expected)
+        fail ("byte %zu of mapping is '%c', not '%c'",
+              i, ACTUAL[i], expected);
+    }
+  msg ("saw child's writes");
+  munmap (map);
+  close (handle);
+}
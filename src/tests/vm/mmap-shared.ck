@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mmap-shared) begin
+(mmap-shared) create "data"
+(mmap-shared) open "data"
+(mmap-shared) write "data"
+(mmap-shared) mmap "data"
+(mmap-shared) exec "child-mm-shr"
+(child-mm-shr) begin
+(child-mm-shr) open "data"
+(child-mm-shr) mmap "data"
+(child-mm-shr) saw parent's write
+(child-mm-shr) end
+(mmap-shared) wait for child (should return 0)
+(mmap-shared) saw child's writes
+(mmap-shared) end
+EOF
+pass;
@@ -0,0 +1,29 @@
+/* Writes to a file through a mapping and calls msync(), then
+   reads the file through another handle while it is still
+   mapped to check that the data reached it. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ACTUAL ((void *) 0x10000000)
+
+void
+test_main (void)
+{
+  int handle;
+  mapid_t map;
+
+  CHECK (create ("sample.txt", strlen (sample)), "create \"sample.txt\"");
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK ((map = mmap (handle, ACTUAL)) != MAP_FAILED, "mmap \"sample.txt\"");
+  memcpy (ACTUAL, sample, strlen (sample));
+  CHECK (msync (map) == 0, "msync \"sample.txt\"");
+  CHECK (msync (map + 1) == -1, "msync bad mapping");
+
+  check_file ("sample.txt", sample, strlen (sample));
+  munmap (map);
+  close (handle);
+}
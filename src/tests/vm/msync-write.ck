@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(msync-write) begin
+(msync-write) create "sample.txt"
+(msync-write) open "sample.txt"
+(msync-write) mmap "sample.txt"
+(msync-write) msync "sample.txt"
+(msync-write) msync bad mapping
+(msync-write) open "sample.txt" for verification
+(msync-write) verified contents of "sample.txt"
+(msync-write) close "sample.txt"
+(msync-write) end
+EOF
+pass;
@@ -0,0 +1,24 @@
+/* Asks for far more anonymous memory than memory and swap can
+   hold together.  Under the default OOM policy the requests must
+   fail up front, and the process must be able to carry on with
+   smaller ones. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ANON ((void *) 0x20000000)
+#define HUGE (64 * 1024 * 1024)
+
+void
+test_main (void)
+{
+  char *p;
+
+  CHECK (sbrk (HUGE) == (void *) -1, "sbrk 64 MB fails");
+  CHECK (mmap_flags (-1, ANON, HUGE, MAP_ANONYMOUS) == MAP_FAILED,
+         "mmap 64 MB anonymous fails");
+  CHECK ((p = sbrk (4096)) != (void *) -1, "sbrk 4 kB");
+  memset (p, 0x5a, 4096);
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(oom-fail) begin
+(oom-fail) sbrk 64 MB fails
+(oom-fail) mmap 64 MB anonymous fails
+(oom-fail) sbrk 4 kB
+(oom-fail) end
+EOF
+pass;
@@ -0,0 +1,21 @@
+/* Runs child-oom, which writes to more memory than memory and
+   swap can hold together, with the kill OOM policy.  The child,
+   as the process with the most resident pages, must be killed,
+   and this process must carry on. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  pid_t child;
+  char *p;
+
+  CHECK ((child = exec ("child-oom")) != -1, "exec \"child-oom\"");
+  CHECK (wait (child) == -1, "wait for child (should return -1)");
+  CHECK ((p = sbrk (4096)) != (void *) -1, "sbrk 4 kB");
+  memset (p, 0x5a, 4096);
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(oom-kill) begin
+(oom-kill) exec "child-oom"
+(child-oom) begin
+(child-oom) sbrk 64 MB
+(oom-kill) wait for child (should return -1)
+(oom-kill) sbrk 4 kB
+(oom-kill) end
+EOF
+pass;
@@ -0,0 +1,48 @@
+/* Fills 1 MB with pages that compress well but differ from each
+   other, with only 64 user pages available, then reads it all
+   back twice.  Most evicted pages should be kept compressed in
+   memory; page-compress.ck checks the kernel's statistics for
+   that. */
+
+#include <string.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGE_CNT 256
+
+static char buf[PAGE_CNT][PAGE_SIZE];
+
+/* Returns the byte expected at offset OFS of page PAGE. */
+static char
+expected (size_t page, size_t ofs)
+{
+  return "compressible text"[ofs % 17] + page % 7;
+}
+
+static void
+check (void)
+{
+  size_t page, ofs;
+
+  for (page = 0; page < PAGE_CNT; page++)
+    for (ofs = 0; ofs < PAGE_SIZE; ofs++)
+      if (buf[page][ofs] != expected (page, ofs))
+        fail ("byte %zu of page %zu changed", ofs, page);
+}
+
+void
+test_main (void)
+{
+  size_t page, ofs;
+
+  msg ("write 1 MB");
+  for (page = 0; page < PAGE_CNT; page++)
+    for (ofs = 0; ofs < PAGE_SIZE; ofs++)
+      buf[page][ofs] = expected (page, ofs);
+
+  msg ("read pass");
+  check ();
+  msg ("read pass");
+  check ();
+}
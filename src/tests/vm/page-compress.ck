@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(page-compress) begin
+(page-compress) write 1 MB
+(page-compress) read pass
+(page-compress) read pass
+(page-compress) end
+EOF
+my (@output) = read_text_file ("$test.output");
+my ($stats) = grep (/^Zswap: \d+ pages stored/, @output);
+fail "missing Zswap statistics at shutdown\n" if !defined $stats;
+my ($stored, $zero, $loaded)
+  = $stats =~ /(\d+) pages stored \((\d+) zero\), (\d+) loaded/;
+fail "no evicted page was kept compressed\n" if $stored - $zero == 0;
+fail "no compressed page was loaded back\n" if $loaded == 0;
+pass;
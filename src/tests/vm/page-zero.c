@@ -0,0 +1,37 @@
+/* Reads every page of a large zero-initialized array before
+   writing any of it, then writes every other page and checks
+   that the pages left alone still read as zeros, so that writes
+   never reach the frame shared by untouched pages. */
+
+#include <string.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGE_CNT 256
+
+static char buf[PAGE_CNT * PAGE_SIZE];
+
+void
+test_main (void)
+{
+  size_t i;
+
+  msg ("read pass");
+  for (i = 0; i < sizeof buf; i++)
+    if (buf[i] != 0)
+      fail ("byte %zu != 0 before any write", i);
+
+  msg ("write every other page");
+  for (i = 0; i < PAGE_CNT; i += 2)
+    memset (buf + i * PAGE_SIZE, i + 1, PAGE_SIZE);
+
+  msg ("read pass");
+  for (i = 0; i < sizeof buf; i++)
+    {
+      size_t page = i / PAGE_SIZE;
+      char expected = page % 2 == 0 ? page + 1 : 0;
+      if (buf[i] != expected)
+        fail ("byte %zu != %d", i, expected);
+    }
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(page-zero) begin
+(page-zero) read pass
+(page-zero) write every other page
+(page-zero) read pass
+(page-zero) end
+EOF
+pass;
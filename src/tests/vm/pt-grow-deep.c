@@ -0,0 +1,36 @@
+/* Recurses through 1.5 MB of stack, more than the default stack
+   size, which the kernel is told to raise to 2 MB with the
+   -stack option.  Each level fills a buffer of its own and
+   checks it again on the way back up.  This must succeed. */
+
+#include <string.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FRAME_SIZE 1024
+#define DEPTH 1536
+
+/* Recurses DEPTH levels deep, returning the number of levels
+   whose buffers held their contents. */
+static int
+recurse (int depth)
+{
+  char buf[FRAME_SIZE];
+  int intact, i;
+
+  if (depth == 0)
+    return 0;
+  memset (buf, depth, sizeof buf);
+  intact = recurse (depth - 1);
+  for (i = 0; i < FRAME_SIZE; i++)
+    if (buf[i] != (char) depth)
+      return intact;
+  return intact + 1;
+}
+
+void
+test_main (void)
+{
+  CHECK (recurse (DEPTH) == DEPTH, "recurse %d levels", DEPTH);
+  CHECK (recurse (DEPTH) == DEPTH, "recurse %d levels again", DEPTH);
+}
@@ -0,0 +1,30 @@
+/* Recurses through 512 kB of stack when the kernel is told to
+   allow only 256 kB with the -stack option.
+   The process must be terminated with -1 exit code. */
+
+#include <string.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FRAME_SIZE 1024
+#define DEPTH 512
+
+/* Recurses DEPTH levels deep, using a buffer at each level. */
+static int
+recurse (int depth)
+{
+  char buf[FRAME_SIZE];
+
+  if (depth == 0)
+    return 0;
+  memset (buf, depth, sizeof buf);
+  return recurse (depth - 1) + buf[depth % FRAME_SIZE];
+}
+
+void
+test_main (void)
+{
+  msg ("recurse %d levels", DEPTH);
+  recurse (DEPTH);
+  fail ("should have exited with -1");
+}
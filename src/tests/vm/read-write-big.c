@@ -0,0 +1,35 @@
+/* Writes a 512 kB buffer to a file with a single write() and
+   reads it back into another with a single read().  The kernel
+   is run with only 64 user pages, so neither buffer fits in
+   memory at once while the system call copies it. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/arc4.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (512 * 1024)
+
+static char out[SIZE];
+static char in[SIZE];
+
+void
+test_main (void)
+{
+  struct arc4 arc4;
+  int handle;
+
+  arc4_init (&arc4, "foobar", 6);
+  arc4_crypt (&arc4, out, SIZE);
+
+  CHECK (create ("big", 0), "create \"big\"");
+  CHECK ((handle = open ("big")) > 1, "open \"big\"");
+  CHECK (write (handle, out, SIZE) == SIZE, "write 512 kB at once");
+  seek (handle, 0);
+  CHECK (read (handle, in, SIZE) == SIZE, "read 512 kB at once");
+  close (handle);
+
+  if (memcmp (in, out, SIZE))
+    fail ("data read differs from data written");
+}
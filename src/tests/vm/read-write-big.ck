@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(read-write-big) begin
+(read-write-big) create "big"
+(read-write-big) open "big"
+(read-write-big) write 512 kB at once
+(read-write-big) read 512 kB at once
+(read-write-big) end
+EOF
+pass;
@@ -0,0 +1,48 @@
+/* Grows the heap with sbrk(), checks that the new memory reads
+   as zeros and keeps what is written to it, then shrinks the
+   heap back and grows it again to see that the released pages
+   come back zeroed. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (5 * 4096 + 123)
+
+static void
+check_zeros (const char *p, size_t size)
+{
+  size_t i;
+
+  for (i = 0; i < size; i++)
+    if (p[i] != 0)
+      fail ("byte %zu of new heap != 0", i);
+}
+
+void
+test_main (void)
+{
+  char *start, *p;
+  size_t i;
+
+  CHECK ((start = sbrk (0)) != (void *) -1, "sbrk (0)");
+  CHECK (sbrk (SIZE) == start, "sbrk (%d)", SIZE);
+  CHECK (sbrk (0) == start + SIZE, "break moved by %d bytes", SIZE);
+
+  msg ("check new heap is zeroed");
+  check_zeros (start, SIZE);
+  for (i = 0; i < SIZE; i++)
+    start[i] = i % 251;
+  for (i = 0; i < SIZE; i++)
+    if (start[i] != (char) (i % 251))
+      fail ("byte %zu of heap changed", i);
+
+  CHECK (sbrk (-SIZE) == start + SIZE, "sbrk (%d)", -SIZE);
+  CHECK (sbrk (0) == start, "break back at start");
+  CHECK (sbrk (-4096) == (void *) -1, "shrinking below the heap fails");
+
+  CHECK ((p = sbrk (SIZE)) == start, "sbrk (%d) again", SIZE);
+  msg ("check released pages came back zeroed");
+  check_zeros (p, SIZE);
+}
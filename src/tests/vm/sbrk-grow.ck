@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(sbrk-grow) begin
+(sbrk-grow) sbrk (0)
+(sbrk-grow) sbrk (20603)
+(sbrk-grow) break moved by 20603 bytes
+(sbrk-grow) check new heap is zeroed
+(sbrk-grow) sbrk (-20603)
+(sbrk-grow) break back at start
+(sbrk-grow) shrinking below the heap fails
+(sbrk-grow) sbrk (20603) again
+(sbrk-grow) check released pages came back zeroed
+(sbrk-grow) end
+EOF
+pass;
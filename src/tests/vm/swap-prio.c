@@ -0,0 +1,37 @@
+/* Writes 1 MB of incompressible data with only 64 user pages
+   available and the swap partition given by name and priority
+   on the kernel command line, then checks that swap is in use
+   and that the data comes back intact. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/arc4.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (1024 * 1024)
+
+static char buf[SIZE];
+
+void
+test_main (void)
+{
+  struct vmstat stats;
+  struct arc4 arc4;
+  size_t i;
+
+  msg ("encrypt 1 MB of zeros");
+  arc4_init (&arc4, "foobar", 6);
+  arc4_crypt (&arc4, buf, SIZE);
+
+  vmstat (&stats);
+  CHECK (stats.swap_used > 0 && stats.swap_used <= stats.swap_total,
+         "swap in use");
+
+  msg ("decrypt back to zeros");
+  arc4_init (&arc4, "foobar", 6);
+  arc4_crypt (&arc4, buf, SIZE);
+  for (i = 0; i < SIZE; i++)
+    if (buf[i] != 0)
+      fail ("byte %zu != 0", i);
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(swap-prio) begin
+(swap-prio) encrypt 1 MB of zeros
+(swap-prio) swap in use
+(swap-prio) decrypt back to zeros
+(swap-prio) end
+EOF
+my (@output) = read_text_file ("$test.output");
+fail "swap partition not set up with priority 7\n"
+  if !grep (/^swap: using hda4, \d+ pages, priority 7$/, @output);
+pass;
@@ -0,0 +1,13 @@
+/* Passes a kernel address to vmstat().
+   The process must be terminated with -1 exit code. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  msg ("vmstat(0xc0100000): %d", vmstat ((struct vmstat *) 0xc0100000));
+  fail ("should have exited with -1");
+}
@@ -0,0 +1,36 @@
+/* Touches fresh pages between two calls to vmstat() and checks
+   that the counters moved as they should.  The buffer is page
+   aligned so that none of its pages also holds initialized
+   data. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_CNT 32
+
+static char buf[PAGE_CNT * 4096] __attribute__ ((aligned (4096)));
+
+void
+test_main (void)
+{
+  struct vmstat before, after;
+  size_t i;
+
+  CHECK (vmstat (&before) == 0, "vmstat");
+  for (i = 0; i < PAGE_CNT; i++)
+    buf[i * 4096] = 1;
+  CHECK (vmstat (&after) == 0, "vmstat");
+
+  CHECK (after.zero_fills - before.zero_fills >= PAGE_CNT,
+         "zero fills counted");
+  CHECK (after.minor_faults - before.minor_faults >= PAGE_CNT,
+         "minor faults counted");
+  CHECK (after.major_faults >= before.major_faults
+         && after.file_fills >= before.file_fills
+         && after.clock_scans >= before.clock_scans,
+         "other counters did not go backward");
+  CHECK (after.swap_total > 0 && after.swap_used <= after.swap_total,
+         "swap usage within swap size");
+}
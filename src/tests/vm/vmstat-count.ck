@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(vmstat-count) begin
+(vmstat-count) vmstat
+(vmstat-count) vmstat
+(vmstat-count) zero fills counted
+(vmstat-count) minor faults counted
+(vmstat-count) other counters did not go backward
+(vmstat-count) swap usage within swap size
+(vmstat-count) end
+EOF
+pass;
@@ -18,6 +18,7 @@
 #include "threads/interrupt.h"
 #include "threads/io.h"
 #include "threads/loader.h"
+#include "threads/memstat.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/pte.h"
@@ -38,21 +39,30 @@
 #include "filesys/fsutil.h"
 #endif
 #include "vm/frame.h"
+#include "vm/page.h"
 #include "vm/swap.h"
+#include "vm/prefetch.h"
+#include "vm/mapping.h"
 
 /* Page directory with kernel mappings only. */
 uint32_t *init_page_dir;
 
+/* CPUID leaf 1 EDX bit: Page Size Extension (4 MB pages). */
+#define CPUID_PSE 0x00000008
+
+/* CR4 bit enabling 4 MB pages. */
+#define CR4_PSE 0x00000010
+
 #ifdef FILESYS
 /* -f: Format the file system? */
 static bool format_filesys;
 
 /* -filesys, -scratch, -swap: Names of block devices to use,
-   overriding the defaults. */
+   overriding the defaults.  -swap may name several devices. */
 static const char *filesys_bdev_name;
 static const char *scratch_bdev_name;
 #ifdef VM
-static const char *swap_bdev_name;
+static char *swap_bdev_names;
 #endif
 #endif /* FILESYS */
 
@@ -117,6 +127,7 @@ kernel_main (void)
   syscall_init ();
 #endif
 
+  page_init ();
   frame_table_init();
 
   /* Start thread scheduler and enable interrupts. */
@@ -133,7 +144,10 @@ kernel_main (void)
   filesys_init (format_filesys);
 #endif
 
-  swap_table_init();
+  swap_table_init (swap_bdev_names);
+  prefetch_init ();
+  frame_writeback_init ();
+  mapping_init ();
 
   printf ("Boot complete.\n");
 
@@ -158,16 +172,40 @@ bss_init (void)
   memset (&_start_bss, 0, &_end_bss - &_start_bss);
 }
 
+/* Returns true if the CPU supports 4 MB pages.  See [IA32-v2a]
+   "CPUID--CPU Identification". */
+static bool
+cpu_has_pse (void)
+{
+  uint32_t eax = 1, ebx, ecx, edx;
+  asm ("cpuid" : "+a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx));
+  return (edx & CPUID_PSE) != 0;
+}
+
 /* Populates the base page directory and page table with the
    kernel virtual mapping, and then sets up the CPU to use the
    new page directory.  Points init_page_dir to the page
-   directory it creates. */
+   directory it creates.
+
+   If the CPU supports it, every 4 MB of physical memory that
+   does not hold kernel code is mapped with a single large page,
+   which saves its page table and lots of TLB entries. */
 static void
 paging_init (void)
 {
   uint32_t *pd, *pt;
   size_t page;
   extern char _start, _end_kernel_text;
+  bool pse = cpu_has_pse ();
+
+  if (pse)
+    {
+      /* Enable 4 MB pages.  See [IA32-v3a] 3.6.1 "Paging
+         Options". */
+      uint32_t cr4;
+      asm volatile ("movl %%cr4, %0" : "=r" (cr4));
+      asm volatile ("movl %0, %%cr4" : : "r" (cr4 | CR4_PSE));
+    }
 
   pd = init_page_dir = palloc_get_page (PAL_ASSERT | PAL_ZERO);
   pt = NULL;
@@ -181,6 +219,16 @@ paging_init (void)
 
       if (pd[pde_idx] == 0)
         {
+          size_t large_pages = PTSPAN / PGSIZE;
+          bool large_has_text = vaddr < &_end_kernel_text
+                                && &_start < vaddr + PTSPAN;
+          if (pse && pte_idx == 0 && page + large_pages <= init_ram_pages
+              && !large_has_text)
+            {
+              pd[pde_idx] = pde_create_kernel_large (vaddr, true);
+              page += large_pages - 1;
+              continue;
+            }
           pt = palloc_get_page (PAL_ASSERT | PAL_ZERO);
           pd[pde_idx] = pde_create (pt);
         }
@@ -257,16 +305,35 @@ parse_options (char **argv)
         scratch_bdev_name = value;
 #ifdef VM
       else if (!strcmp (name, "-swap"))
-        swap_bdev_name = value;
+        swap_bdev_names = value;
+      else if (!strcmp (name, "-oom"))
+        {
+          if (value == NULL || !strcmp (value, "fail"))
+            oom_policy = OOM_FAIL;
+          else if (!strcmp (value, "kill"))
+            oom_policy = OOM_KILL;
+          else
+            PANIC ("unknown OOM policy \"%s\"", value);
+        }
 #endif
 #endif
       else if (!strcmp (name, "-rs"))
         random_init (atoi (value));
       else if (!strcmp (name, "-mlfqs"))
         thread_mlfqs = true;
+      else if (!strcmp (name, "-memstat"))
+        memstat_enabled = true;
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
+      else if (!strcmp (name, "-stack"))
+        {
+          int pages = value != NULL ? atoi (value) : 0;
+          if (pages < 1 || pages > STACK_PAGES_MAX)
+            PANIC ("stack size must be between 1 and %d pages, not \"%s\"",
+                   STACK_PAGES_MAX, value != NULL ? value : "");
+          stack_page_limit = pages;
+        }
 #endif
       else
         PANIC ("unknown option `%s' (use -h for help)", name);
@@ -382,13 +449,22 @@ usage (void)
           "  -filesys=BDEV      Use BDEV for file system instead of default.\n"
           "  -scratch=BDEV      Use BDEV for scratch instead of default.\n"
 #ifdef VM
-          "  -swap=BDEV         Use BDEV for swap instead of default.\n"
+          "  -swap=BDEV[:PRIO],...  Swap to BDEVs instead of all swap\n"
+          "                     partitions.  Higher PRIO is used first,\n"
+          "                     equal PRIO devices are striped.\n"
+          "  -oom=POLICY        When memory runs out, fail allocations\n"
+          "                     beyond swap plus RAM (fail, default) or\n"
+          "                     overcommit and kill the biggest process\n"
+          "                     once swap is full (kill).\n"
 #endif
 #endif
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
+          "  -memstat           Account kernel memory by call site.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
+          "  -stack=COUNT       Let user stacks grow to COUNT pages,\n"
+          "                     1 to 65536.\n"
 #endif
           );
   shutdown_power_off ();
@@ -401,9 +477,6 @@ locate_block_devices (void)
 {
   locate_block_device (BLOCK_FILESYS, filesys_bdev_name);
   locate_block_device (BLOCK_SCRATCH, scratch_bdev_name);
-#ifdef VM
-  locate_block_device (BLOCK_SWAP, swap_bdev_name);
-#endif
 }
 
 /* Figures out what block device to use for the given ROLE: the
@@ -11,6 +11,10 @@
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 #include "devices/timer.h"
+#ifdef USERPROG
+#include "userprog/gdt.h"
+#include "userprog/process.h"
+#endif
 
 /* Programmable Interrupt Controller (PIC) registers.
    A PC has two PICs, called the master and slave PICs, with the
@@ -388,6 +392,16 @@ intr_handler (struct intr_frame *frame)
       if (yield_on_return) 
         thread_yield (); 
     }
+
+#ifdef USERPROG
+  /* A process picked by the OOM killer must not run any more user
+     code, even if it never makes a system call or faults again. */
+  if (frame->cs == SEL_UCSEG && process_oom_killed ())
+    {
+      intr_enable ();
+      thread_exit (-1);
+    }
+#endif
 }
 
 /* Handles an unexpected interrupt with interrupt frame F.  An
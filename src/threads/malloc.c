@@ -5,6 +5,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/memstat.h"
 #include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -32,7 +33,11 @@
    because they're too big to fit in a single page with a
    descriptor.  We handle those by allocating contiguous pages
    with the page allocator and sticking the allocation size at
-   the beginning of the allocated block's arena header. */
+   the beginning of the allocated block's arena header.
+
+   With memory accounting enabled, each block is preceded by a
+   tag that records its size and the call site it is charged to
+   (see memstat.c). */
 
 /* Descriptor. */
 struct desc
@@ -60,12 +65,21 @@ struct block
     struct list_elem free_elem; /* Free list element. */
   };
 
+/* Accounting tag, in front of each block when memstat_enabled. */
+struct tag
+  {
+    unsigned site;              /* Call site charged for the block. */
+    size_t size;                /* Bytes requested. */
+  };
+
 /* Our set of descriptors. */
 static struct desc descs[10];   /* Descriptors. */
 static size_t desc_cnt;         /* Number of descriptors. */
 
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
+static void *malloc_at (size_t, const void *caller);
+static void free_block (void *);
 
 /* Initializes the malloc() descriptors. */
 void
@@ -88,6 +102,14 @@ malloc_init (void)
    Returns a null pointer if memory is not available. */
 void *
 malloc (size_t size) 
+{
+  return malloc_at (size, __builtin_return_address (0));
+}
+
+/* Obtains and returns a new block of at least SIZE bytes, not
+   counting any accounting tag. */
+static void *
+alloc_block (size_t size) 
 {
   struct desc *d;
   struct block *b;
@@ -167,7 +189,7 @@ calloc (size_t a, size_t b)
     return NULL;
 
   /* Allocate and zero memory. */
-  p = malloc (size);
+  p = malloc_at (size, __builtin_return_address (0));
   if (p != NULL)
     memset (p, 0, size);
 
@@ -185,6 +207,36 @@ block_size (void *block)
   return d != NULL ? d->block_size : PGSIZE * a->free_cnt - pg_ofs (block);
 }
 
+/* Returns the number of bytes usable in BLOCK, which was
+   returned by malloc_at(). */
+static size_t
+usable_size (void *block) 
+{
+  if (memstat_enabled)
+    return ((struct tag *) block - 1)->size;
+  return block_size (block);
+}
+
+/* Obtains and returns a new block of at least SIZE bytes,
+   charging it to CALLER if memory accounting is enabled. */
+static void *
+malloc_at (size_t size, const void *caller) 
+{
+  struct tag *t;
+
+  if (!memstat_enabled)
+    return alloc_block (size);
+
+  if (size == 0 || size > SIZE_MAX - sizeof *t)
+    return NULL;
+  t = alloc_block (size + sizeof *t);
+  if (t == NULL)
+    return NULL;
+  t->site = memstat_alloc (MEMSTAT_MALLOC, caller, 1, size);
+  t->size = size;
+  return t + 1;
+}
+
 /* Attempts to resize OLD_BLOCK to NEW_SIZE bytes, possibly
    moving it in the process.
    If successful, returns the new block; on failure, returns a
@@ -201,10 +253,10 @@ realloc (void *old_block, size_t new_size)
     }
   else 
     {
-      void *new_block = malloc (new_size);
+      void *new_block = malloc_at (new_size, __builtin_return_address (0));
       if (old_block != NULL && new_block != NULL)
         {
-          size_t old_size = block_size (old_block);
+          size_t old_size = usable_size (old_block);
           size_t min_size = new_size < old_size ? new_size : old_size;
           memcpy (new_block, old_block, min_size);
           free (old_block);
@@ -217,6 +269,19 @@ realloc (void *old_block, size_t new_size)
    malloc(), calloc(), or realloc(). */
 void
 free (void *p) 
+{
+  if (p != NULL && memstat_enabled)
+    {
+      struct tag *t = (struct tag *) p - 1;
+      memstat_free (MEMSTAT_MALLOC, t->site, 1, t->size);
+      p = t;
+    }
+  free_block (p);
+}
+
+/* Frees block P, including any accounting tag. */
+static void
+free_block (void *p) 
 {
   if (p != NULL)
     {
@@ -0,0 +1,143 @@
+#include "threads/memstat.h"
+#include <debug.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "threads/interrupt.h"
+
+/* Kernel memory accounting.
+
+   When enabled, malloc(), the page allocator and the object
+   caches report every allocation here along with the address it
+   was called from, and remember the returned "site" number with
+   the memory so that freeing it is charged back to the same
+   site.  Each site keeps its live objects and bytes and its
+   high-water mark, so that leaks show up as live objects at
+   shutdown and pools can be sized from the peaks.  The addresses
+   can be turned into function names with the "backtrace"
+   utility.  The pages that back object caches are charged to
+   slab.c as well, so the slab totals overlap the palloc totals.
+
+   The table has a fixed size, because it cannot allocate memory
+   itself.  Site 0 collects whatever does not fit.  It is
+   updated with interrupts off, because pages are freed from
+   within the scheduler. */
+
+/* Number of sites, including the overflow site.  Site numbers
+   must fit in a byte. */
+#define MEMSTAT_SITES 256
+
+/* An allocation call site. */
+struct site
+  {
+    const void *caller;         /* Return address of the allocation. */
+    enum memstat_kind kind;     /* What it allocates. */
+    size_t live_cnt;            /* Objects (or pages) not yet freed. */
+    size_t live_bytes;          /* Bytes not yet freed. */
+    size_t peak_bytes;          /* Most LIVE_BYTES ever reached. */
+    unsigned long long alloc_cnt; /* Number of allocations. */
+  };
+
+bool memstat_enabled;
+
+static struct site sites[MEMSTAT_SITES];
+
+/* Live and peak bytes of each kind, over all sites. */
+static size_t total_bytes[3];
+static size_t total_peak[3];
+
+/* Returns the number of the site for KIND allocations from
+   CALLER, creating it if necessary.  Returns 0 if the table is
+   full. */
+static unsigned
+lookup_site (enum memstat_kind kind, const void *caller)
+{
+  unsigned start = ((uintptr_t) caller ^ kind) % (MEMSTAT_SITES - 1);
+  unsigned i = start;
+
+  do
+    {
+      struct site *s = &sites[i + 1];
+      if (s->caller == NULL)
+        {
+          s->caller = caller;
+          s->kind = kind;
+          return i + 1;
+        }
+      if (s->caller == caller && s->kind == kind)
+        return i + 1;
+      i = (i + 1) % (MEMSTAT_SITES - 1);
+    }
+  while (i != start);
+  return 0;
+}
+
+/* Records an allocation of CNT objects totalling BYTES bytes of
+   KIND memory made from CALLER, and returns its site number,
+   to be passed to memstat_free() when it is freed. */
+unsigned
+memstat_alloc (enum memstat_kind kind, const void *caller,
+               size_t cnt, size_t bytes)
+{
+  enum intr_level old_level = intr_disable ();
+  unsigned site = lookup_site (kind, caller);
+  struct site *s = &sites[site];
+
+  s->live_cnt += cnt;
+  s->live_bytes += bytes;
+  if (s->live_bytes > s->peak_bytes)
+    s->peak_bytes = s->live_bytes;
+  s->alloc_cnt++;
+  total_bytes[kind] += bytes;
+  if (total_bytes[kind] > total_peak[kind])
+    total_peak[kind] = total_bytes[kind];
+  intr_set_level (old_level);
+  return site;
+}
+
+/* Records that CNT objects totalling BYTES bytes of KIND memory
+   allocated at SITE have been freed. */
+void
+memstat_free (enum memstat_kind kind, unsigned site, size_t cnt,
+              size_t bytes)
+{
+  enum intr_level old_level;
+  struct site *s;
+
+  ASSERT (site < MEMSTAT_SITES);
+  old_level = intr_disable ();
+  s = &sites[site];
+  ASSERT (s->live_cnt >= cnt && s->live_bytes >= bytes);
+  s->live_cnt -= cnt;
+  s->live_bytes -= bytes;
+  total_bytes[kind] -= bytes;
+  intr_set_level (old_level);
+}
+
+/* Prints the usage of every call site that has allocated
+   anything.  The numbers may be slightly inconsistent if memory
+   is allocated meanwhile. */
+void
+memstat_print_stats (void)
+{
+  static const char *kind_names[] = { "malloc", "palloc", "slab" };
+  size_t i;
+
+  if (!memstat_enabled)
+    return;
+
+  printf ("Kernel memory: malloc %zu bytes (peak %zu), "
+          "palloc %zu bytes (peak %zu), slab %zu bytes (peak %zu)\n",
+          total_bytes[MEMSTAT_MALLOC], total_peak[MEMSTAT_MALLOC],
+          total_bytes[MEMSTAT_PALLOC], total_peak[MEMSTAT_PALLOC],
+          total_bytes[MEMSTAT_SLAB], total_peak[MEMSTAT_SLAB]);
+  for (i = 0; i < MEMSTAT_SITES; i++)
+    {
+      struct site *s = &sites[i];
+      if (s->alloc_cnt == 0)
+        continue;
+      printf ("  %p %s: %zu live, %zu bytes, peak %zu bytes, "
+              "%llu allocations\n",
+              s->caller, i == 0 ? "other" : kind_names[s->kind],
+              s->live_cnt, s->live_bytes, s->peak_bytes, s->alloc_cnt);
+    }
+}
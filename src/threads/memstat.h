@@ -0,0 +1,25 @@
+#ifndef THREADS_MEMSTAT_H
+#define THREADS_MEMSTAT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Kernel memory accounting by allocation call site.
+   Controlled by kernel command-line option "-memstat". */
+extern bool memstat_enabled;
+
+/* What a call site allocates. */
+enum memstat_kind
+  {
+    MEMSTAT_MALLOC,             /* Blocks from malloc(). */
+    MEMSTAT_PALLOC,             /* Pages from palloc_get_*(). */
+    MEMSTAT_SLAB                /* Objects from kmem_cache_alloc(). */
+  };
+
+unsigned memstat_alloc (enum memstat_kind, const void *caller,
+                        size_t cnt, size_t bytes);
+void memstat_free (enum memstat_kind, unsigned site, size_t cnt,
+                   size_t bytes);
+void memstat_print_stats (void);
+
+#endif /* threads/memstat.h */
@@ -2,13 +2,15 @@
 #include <bitmap.h>
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/interrupt.h"
 #include "threads/loader.h"
-#include "threads/synch.h"
+#include "threads/memstat.h"
 #include "threads/vaddr.h"
 
 /* Page allocator.  Hands out memory in page-size (or
@@ -23,13 +25,34 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   kernel pool, but that's just fine for demonstration purposes.
+
+   Each pool is a buddy allocator.  Free pages are kept in blocks
+   of 2**ORDER pages, aligned to their size within the pool, on
+   one free list per order.  A request is served from the
+   smallest block big enough, splitting larger blocks as needed,
+   and any pages beyond PAGE_CNT are given straight back.  A
+   freed block is merged with its "buddy", the other half of the
+   block it was split from, whenever that is free too.  Both take
+   O(log n) steps however fragmented the pool is.
+
+   The free lists are threaded through the free pages
+   themselves.  Pages are freed from within the scheduler, where
+   sleeping on a lock is not allowed, so they are protected by
+   disabling interrupts rather than by a lock. */
+
+/* Largest block order.  A pool of up to 2**MAX_ORDER pages
+   (4 GB) can be handed out in one piece. */
+#define MAX_ORDER 20
 
 /* A memory pool. */
 struct pool
   {
-    struct lock lock;                   /* Mutual exclusion. */
     struct bitmap *used_map;            /* Bitmap of free pages. */
+    uint8_t *orders;                    /* Per page: 1 + order of the
+                                           free block it heads, or 0. */
+    uint8_t *sites;                     /* Per page: memstat site. */
+    struct list free_lists[MAX_ORDER + 1]; /* Free blocks by order. */
     uint8_t *base;                      /* Base of pool. */
   };
 
@@ -39,6 +62,9 @@ static struct pool kernel_pool, user_pool;
 static void init_pool (struct pool *, void *base, size_t page_cnt,
                        const char *name);
 static bool page_from_pool (const struct pool *, void *page);
+static void free_range (struct pool *, size_t page_idx, size_t page_cnt);
+static void *get_multiple (enum palloc_flags, size_t page_cnt,
+                           const void *caller);
 
 /* Initializes the page allocator.  At most USER_PAGE_LIMIT
    pages are put into the user pool. */
@@ -69,22 +95,64 @@ palloc_init (size_t user_page_limit)
    FLAGS, in which case the kernel panics. */
 void *
 palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
+{
+  return get_multiple (flags, page_cnt, __builtin_return_address (0));
+}
+
+/* Obtains PAGE_CNT contiguous pages as palloc_get_multiple()
+   does, charging them to CALLER if memory accounting is
+   enabled. */
+static void *
+get_multiple (enum palloc_flags flags, size_t page_cnt, const void *caller)
 {
   struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
-  void *pages;
-  size_t page_idx;
+  void *pages = NULL;
+  enum intr_level old_level;
+  int order, k;
 
   if (page_cnt == 0)
     return NULL;
 
-  lock_acquire (&pool->lock);
-  page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
-  lock_release (&pool->lock);
+  /* Find the smallest order that fits PAGE_CNT pages. */
+  for (order = 0; order <= MAX_ORDER; order++)
+    if (((size_t) 1 << order) >= page_cnt)
+      break;
 
-  if (page_idx != BITMAP_ERROR)
-    pages = pool->base + PGSIZE * page_idx;
-  else
-    pages = NULL;
+  old_level = intr_disable ();
+  for (k = order; k <= MAX_ORDER; k++)
+    if (!list_empty (&pool->free_lists[k]))
+      break;
+  if (k <= MAX_ORDER)
+    {
+      struct list_elem *e = list_pop_front (&pool->free_lists[k]);
+      size_t page_idx = ((uint8_t *) e - pool->base) / PGSIZE;
+      pool->orders[page_idx] = 0;
+
+      /* Split the block down to ORDER, freeing the upper halves,
+         then give back the pages past PAGE_CNT. */
+      while (k > order)
+        {
+          size_t buddy;
+
+          k--;
+          buddy = page_idx + ((size_t) 1 << k);
+          pool->orders[buddy] = k + 1;
+          list_push_front (&pool->free_lists[k],
+                           (struct list_elem *) (pool->base
+                                                 + PGSIZE * buddy));
+        }
+      free_range (pool, page_idx + page_cnt,
+                  ((size_t) 1 << order) - page_cnt);
+
+      ASSERT (bitmap_none (pool->used_map, page_idx, page_cnt));
+      bitmap_set_multiple (pool->used_map, page_idx, page_cnt, true);
+      pages = pool->base + PGSIZE * page_idx;
+      if (memstat_enabled)
+        memset (pool->sites + page_idx,
+                memstat_alloc (MEMSTAT_PALLOC, caller, page_cnt,
+                               PGSIZE * page_cnt), page_cnt);
+    }
+  intr_set_level (old_level);
 
   if (pages != NULL) 
     {
@@ -110,7 +178,7 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
 void *
 palloc_get_page (enum palloc_flags flags) 
 {
-  return palloc_get_multiple (flags, 1);
+  return get_multiple (flags, 1, __builtin_return_address (0));
 }
 
 /* Frees the PAGE_CNT pages starting at PAGES. */
@@ -119,6 +187,7 @@ palloc_free_multiple (void *pages, size_t page_cnt)
 {
   struct pool *pool;
   size_t page_idx;
+  enum intr_level old_level;
 
   ASSERT (pg_ofs (pages) == 0);
   if (pages == NULL || page_cnt == 0)
@@ -137,8 +206,17 @@ palloc_free_multiple (void *pages, size_t page_cnt)
   memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
 
+  old_level = intr_disable ();
   ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
   bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+  if (memstat_enabled)
+    {
+      size_t i;
+      for (i = page_idx; i < page_idx + page_cnt; i++)
+        memstat_free (MEMSTAT_PALLOC, pool->sites[i], 1, PGSIZE);
+    }
+  free_range (pool, page_idx, page_cnt);
+  intr_set_level (old_level);
 }
 
 /* Frees the page at PAGE. */
@@ -148,25 +226,84 @@ palloc_free_page (void *page)
   palloc_free_multiple (page, 1);
 }
 
+/* Returns the number of pages in the user pool, free or not. */
+size_t
+palloc_user_page_cnt (void)
+{
+  return bitmap_size (user_pool.used_map);
+}
+
 /* Initializes pool P as starting at START and ending at END,
    naming it NAME for debugging purposes. */
 static void
 init_pool (struct pool *p, void *base, size_t page_cnt, const char *name) 
 {
-  /* We'll put the pool's used_map at its base.
-     Calculate the space needed for the bitmap
-     and subtract it from the pool's size. */
-  size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (page_cnt), PGSIZE);
+  /* We'll put the pool's used_map, block orders and memstat
+     sites at its base.  Calculate the space needed for them and
+     subtract it from the pool's size. */
+  size_t bm_size = bitmap_buf_size (page_cnt);
+  size_t bm_pages = DIV_ROUND_UP (bm_size + 2 * page_cnt, PGSIZE);
+  int order;
   if (bm_pages > page_cnt)
     PANIC ("Not enough memory in %s for bitmap.", name);
   page_cnt -= bm_pages;
 
   printf ("%zu pages available in %s.\n", page_cnt, name);
 
-  /* Initialize the pool. */
-  lock_init (&p->lock);
-  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_pages * PGSIZE);
+  /* Initialize the pool, with all of its pages free. */
+  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_size);
+  p->orders = (uint8_t *) base + bm_size;
+  memset (p->orders, 0, page_cnt);
+  p->sites = p->orders + page_cnt;
+  for (order = 0; order <= MAX_ORDER; order++)
+    list_init (&p->free_lists[order]);
   p->base = base + bm_pages * PGSIZE;
+  free_range (p, 0, page_cnt);
+}
+
+/* Frees the block of 2**ORDER pages at PAGE_IDX in POOL, merging
+   it with its buddy for as long as that is free too.  Must be
+   called with interrupts off. */
+static void
+free_block (struct pool *pool, size_t page_idx, int order)
+{
+  size_t page_cnt = bitmap_size (pool->used_map);
+
+  while (order < MAX_ORDER)
+    {
+      size_t buddy = page_idx ^ ((size_t) 1 << order);
+      if (buddy + ((size_t) 1 << order) > page_cnt
+          || pool->orders[buddy] != order + 1)
+        break;
+      list_remove ((struct list_elem *) (pool->base + PGSIZE * buddy));
+      pool->orders[buddy] = 0;
+      if (buddy < page_idx)
+        page_idx = buddy;
+      order++;
+    }
+  pool->orders[page_idx] = order + 1;
+  list_push_front (&pool->free_lists[order],
+                   (struct list_elem *) (pool->base + PGSIZE * page_idx));
+}
+
+/* Frees the PAGE_CNT pages at PAGE_IDX in POOL, which need not
+   form a single block, as the largest aligned blocks that fit.
+   Must be called with interrupts off. */
+static void
+free_range (struct pool *pool, size_t page_idx, size_t page_cnt)
+{
+  size_t end = page_idx + page_cnt;
+
+  while (page_idx < end)
+    {
+      int order = 0;
+      while (order < MAX_ORDER
+             && page_idx % ((size_t) 2 << order) == 0
+             && page_idx + ((size_t) 2 << order) <= end)
+        order++;
+      free_block (pool, page_idx, order);
+      page_idx += (size_t) 1 << order;
+    }
 }
 
 /* Returns true if PAGE was allocated from POOL,
@@ -0,0 +1,230 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/memstat.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* An object cache allocator, for kernel objects that are
+   allocated and freed often.
+
+   malloc() rounds every request up to a power of 2 and takes a
+   lock per size class.  A cache instead serves objects of
+   exactly one size, so a 540-byte object takes 540 bytes rather
+   than 1 kB.  Objects are carved out of one-page "slabs" whose
+   header sits at the start of the page, so freeing an object
+   finds its slab by rounding its address down.
+
+   Each slab keeps a list of its freed objects, which are handed
+   out again before fresh ones, and the cache keeps the slabs
+   that still have free objects.  A slab that becomes entirely
+   free goes back to the page allocator, unless it is the last
+   one with room, so that an object bouncing between alloc and
+   free does not cycle pages.
+
+   If the cache has a constructor, it runs once, when an object
+   is first carved out of its slab.  Freed objects must be
+   returned in their constructed state, so the free list link is
+   kept past the end of the object instead of overlapping it.
+
+   When memory accounting is enabled, each object also records
+   the memstat site of the code that allocated it, past the end
+   of the object and its link, so that a leaked object is charged
+   to its real call site rather than to the palloc_get_page()
+   call here.
+
+   The critical sections are a handful of instructions, so they
+   run with interrupts off instead of taking a lock. */
+
+/* Magic number for detecting slab corruption. */
+#define SLAB_MAGIC 0x51ab51ab
+
+/* Slab. */
+struct slab
+  {
+    unsigned magic;             /* Always set to SLAB_MAGIC. */
+    struct kmem_cache *cache;   /* Owning cache. */
+    struct list_elem elem;      /* Element in cache's partial list. */
+    void *free_list;            /* Freed objects in this slab. */
+    size_t free_cnt;            /* Number of free objects. */
+    size_t unused_idx;          /* First object never handed out. */
+  };
+
+/* All caches, for statistics. */
+static struct list all_caches = LIST_INITIALIZER (all_caches);
+
+/* Returns the free list link of OBJ in cache C. */
+static void **
+obj_link (const struct kmem_cache *c, void *obj)
+{
+  return (void **) ((uint8_t *) obj + c->link_ofs);
+}
+
+/* Returns the IDX'th object within slab S. */
+static void *
+slab_to_obj (struct slab *s, size_t idx)
+{
+  ASSERT (idx < s->cache->objs_per_slab);
+  return (uint8_t *) (s + 1) + idx * s->cache->obj_size;
+}
+
+/* Initializes C as a cache of objects of SIZE bytes, named NAME.
+   If CTOR is non-null, it is called on each new object. */
+void
+kmem_cache_init (struct kmem_cache *c, const char *name, size_t size,
+                 void (*ctor) (void *))
+{
+  enum intr_level old_level;
+
+  ASSERT (size > 0);
+  size = ROUND_UP (size, sizeof (void *));
+
+  c->name = name;
+  c->ctor = ctor;
+  c->link_ofs = ctor != NULL ? size : 0;
+  c->obj_size = ctor != NULL ? size + sizeof (void *) : size;
+  c->site_ofs = 0;
+  if (memstat_enabled)
+    {
+      c->site_ofs = c->obj_size;
+      c->obj_size += sizeof (void *);
+    }
+  c->objs_per_slab = (PGSIZE - sizeof (struct slab)) / c->obj_size;
+  ASSERT (c->objs_per_slab > 0);
+  list_init (&c->partial);
+  c->slab_cnt = 0;
+  c->active_cnt = 0;
+  c->alloc_cnt = 0;
+
+  old_level = intr_disable ();
+  list_push_back (&all_caches, &c->elem);
+  intr_set_level (old_level);
+}
+
+/* Obtains and returns a new object from cache C.  Returns a null
+   pointer if memory is not available. */
+void *
+kmem_cache_alloc (struct kmem_cache *c)
+{
+  enum intr_level old_level;
+  struct slab *s;
+  void *obj;
+  bool fresh = false;
+
+  old_level = intr_disable ();
+  if (list_empty (&c->partial))
+    {
+      /* No slab has a free object, so create a new one. */
+      intr_set_level (old_level);
+      s = palloc_get_page (0);
+      if (s == NULL)
+        return NULL;
+      s->magic = SLAB_MAGIC;
+      s->cache = c;
+      s->free_list = NULL;
+      s->free_cnt = c->objs_per_slab;
+      s->unused_idx = 0;
+
+      old_level = intr_disable ();
+      list_push_front (&c->partial, &s->elem);
+      c->slab_cnt++;
+    }
+
+  /* Prefer recently freed objects, which are likely still in
+     the cache, then carve a fresh one. */
+  s = list_entry (list_front (&c->partial), struct slab, elem);
+  if (s->free_list != NULL)
+    {
+      obj = s->free_list;
+      s->free_list = *obj_link (c, obj);
+    }
+  else
+    {
+      obj = slab_to_obj (s, s->unused_idx++);
+      fresh = true;
+    }
+  if (--s->free_cnt == 0)
+    list_remove (&s->elem);
+  c->active_cnt++;
+  c->alloc_cnt++;
+  intr_set_level (old_level);
+
+  if (c->site_ofs != 0)
+    *(unsigned *) ((uint8_t *) obj + c->site_ofs)
+      = memstat_alloc (MEMSTAT_SLAB, __builtin_return_address (0), 1,
+                       c->obj_size);
+  if (fresh && c->ctor != NULL)
+    c->ctor (obj);
+  return obj;
+}
+
+/* Returns OBJ, which must have been obtained from cache C, to
+   C.  A null OBJ is ignored. */
+void
+kmem_cache_free (struct kmem_cache *c, void *obj)
+{
+  enum intr_level old_level;
+  struct slab *s;
+
+  if (obj == NULL)
+    return;
+
+  /* Check that the object belongs to C and is properly aligned. */
+  s = pg_round_down (obj);
+  ASSERT (s->magic == SLAB_MAGIC);
+  ASSERT (s->cache == c);
+  ASSERT (((uint8_t *) obj - (uint8_t *) (s + 1)) % c->obj_size == 0);
+
+  if (c->site_ofs != 0)
+    memstat_free (MEMSTAT_SLAB, *(unsigned *) ((uint8_t *) obj + c->site_ofs),
+                  1, c->obj_size);
+
+#ifndef NDEBUG
+  /* Clear the object to help detect use-after-free bugs, unless
+     it must stay constructed. */
+  if (c->ctor == NULL)
+    memset (obj, 0xcc, c->obj_size);
+#endif
+
+  old_level = intr_disable ();
+  *obj_link (c, obj) = s->free_list;
+  s->free_list = obj;
+  c->active_cnt--;
+  if (s->free_cnt++ == 0)
+    list_push_front (&c->partial, &s->elem);
+
+  /* If the slab is now entirely unused and is not the last one
+     with room, give it back. */
+  if (s->free_cnt == c->objs_per_slab
+      && (list_front (&c->partial) != &s->elem
+          || list_next (&s->elem) != list_end (&c->partial)))
+    {
+      list_remove (&s->elem);
+      c->slab_cnt--;
+      intr_set_level (old_level);
+      palloc_free_page (s);
+      return;
+    }
+  intr_set_level (old_level);
+}
+
+/* Prints statistics about every cache. */
+void
+kmem_cache_print_stats (void)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&all_caches); e != list_end (&all_caches);
+       e = list_next (e))
+    {
+      struct kmem_cache *c = list_entry (e, struct kmem_cache, elem);
+      printf ("Cache %s: %zu of %zu objects in use in %zu slabs, "
+              "%llu allocations\n",
+              c->name, c->active_cnt, c->slab_cnt * c->objs_per_slab,
+              c->slab_cnt, c->alloc_cnt);
+    }
+}
@@ -0,0 +1,30 @@
+#ifndef THREADS_SLAB_H
+#define THREADS_SLAB_H
+
+#include <list.h>
+#include <stddef.h>
+
+/* An object cache.  Hands out objects of a single size, carved
+   from pages called "slabs".  See slab.c for details. */
+struct kmem_cache
+  {
+    struct list_elem elem;      /* Element in list of all caches. */
+    const char *name;           /* Name, for statistics. */
+    size_t obj_size;            /* Bytes per object, including link. */
+    size_t link_ofs;            /* Offset of free list link in object. */
+    size_t site_ofs;            /* Offset of memstat site, or 0. */
+    size_t objs_per_slab;       /* Number of objects in a slab. */
+    void (*ctor) (void *);      /* Constructor, or a null pointer. */
+    struct list partial;        /* Slabs with free objects. */
+    size_t slab_cnt;            /* Number of slabs. */
+    size_t active_cnt;          /* Objects handed out. */
+    unsigned long long alloc_cnt; /* Calls to kmem_cache_alloc(). */
+  };
+
+void kmem_cache_init (struct kmem_cache *, const char *name, size_t size,
+                      void (*ctor) (void *));
+void *kmem_cache_alloc (struct kmem_cache *) __attribute__ ((malloc));
+void kmem_cache_free (struct kmem_cache *, void *);
+void kmem_cache_print_stats (void);
+
+#endif /* threads/slab.h */
@@ -12,6 +12,7 @@
 #include "userprog/pagedir.h"
 #include "userprog/process.h"
 #include "vm/frame.h"
+#include "userprog/uaccess.h"
 
 /* Number of page faults processed. */
 static long long page_fault_cnt;
@@ -131,7 +132,7 @@ static void
 page_fault (struct intr_frame *f)
 {
   bool not_present; /* True: not-present page, false: writing r/o page. */
-  bool write UNUSED; /* True: access was write, false: access was read. */
+  bool write; /* True: access was write, false: access was read. */
   bool user; /* True: access by user, false: access by kernel. */
   void *fault_addr; /* Fault address. */
 
@@ -160,19 +161,44 @@ page_fault (struct intr_frame *f)
 //	      not_present ? "not present" : "rights violation",
 //	      write ? "writing" : "reading", user ? "user" : "kernel");
 
-  if (user && not_present)
+  // Picked by the OOM killer while running
+  if (user && thread_current ()->p->oom_killed)
     {
-      if (retrieve_page (fault_addr, false))
+      thread_exit (-1);
+    }
+
+  if (user && (not_present || write))
+    {
+      if (retrieve_page (fault_addr, write, false))
 	{
 	  return;
 	}
-      if (grow_stack (fault_addr, f->esp, false))
+      if (not_present && grow_stack (fault_addr, f->esp, false))
 	{
 	  return;
 	}
       thread_exit (-1);
     }
 
+  /* The kernel touching user memory on behalf of a system call.  The
+   interrupted esp is the kernel's, so grow the stack against the one
+   the process made the call with. */
+  uintptr_t fixup = uaccess_fixup ((uintptr_t) f->eip);
+  if (!user && fixup != 0 && is_user_vaddr (fault_addr))
+    {
+      if (retrieve_page (fault_addr, write, false))
+	{
+	  return;
+	}
+      if (not_present
+	  && grow_stack (fault_addr, thread_current ()->p->syscall_esp, false))
+	{
+	  return;
+	}
+      f->eip = (void (*) (void)) fixup;
+      return;
+    }
+
   thread_exit (-1);
 
 }
@@ -6,8 +6,14 @@
 #include "threads/pte.h"
 #include "threads/palloc.h"
 
+/* Largest number of pages worth invalidating one at a time with
+   invlpg.  Beyond this, reloading CR3 to flush the whole TLB is
+   cheaper. */
+#define INVLPG_MAX 32
+
 static uint32_t *active_pd (void);
 static void invalidate_pagedir (uint32_t *);
+static void invalidate_page (uint32_t *, const void *);
 
 /* Creates a new page directory that has mappings for kernel
    virtual addresses, but none for user virtual addresses.
@@ -54,7 +60,9 @@ pagedir_destroy (uint32_t *pd)
    If PD does not have a page table for VADDR, behavior depends
    on CREATE.  If CREATE is true, then a new page table is
    created and a pointer into it is returned.  Otherwise, a null
-   pointer is returned. */
+   pointer is returned.
+   Kernel memory mapped with 4 MB pages has no page table entry,
+   so a null pointer is returned for it as well. */
 static uint32_t *
 lookup_page (uint32_t *pd, const void *vaddr, bool create)
 {
@@ -80,6 +88,8 @@ lookup_page (uint32_t *pd, const void *vaddr, bool create)
       else
         return NULL;
     }
+  else if (*pde & PTE_PS)
+    return NULL;
 
   /* Return the page table entry. */
   pt = pde_get_pt (*pde);
@@ -153,10 +163,46 @@ pagedir_clear_page (uint32_t *pd, void *upage)
   if (pte != NULL && (*pte & PTE_P) != 0)
     {
       *pte &= ~PTE_P;
-      invalidate_pagedir (pd);
+      invalidate_page (pd, upage);
     }
 }
 
+/* Marks the PAGE_CNT user virtual pages starting at UPAGE "not
+   present" in page directory PD, like pagedir_clear_page(), but
+   with at most one TLB flush for the whole range.  Ranges without
+   a page table are skipped cheaply, so this can also be used to
+   unmap a whole address space. */
+void
+pagedir_clear_pages (uint32_t *pd, void *upage, size_t page_cnt)
+{
+  uint8_t *va = upage;
+  uint8_t *end = va + page_cnt * PGSIZE;
+  size_t cleared = 0;
+
+  ASSERT (pg_ofs (upage) == 0);
+  ASSERT (page_cnt == 0 || is_user_vaddr (end - 1));
+
+  while (va < end)
+    {
+      uint32_t *pte = lookup_page (pd, va, false);
+      if (pte == NULL)
+        {
+          /* No page table, skip to the next one. */
+          va = (uint8_t *) ((uintptr_t) va & PDMASK) + PTSPAN;
+          continue;
+        }
+      if ((*pte & PTE_P) != 0)
+        {
+          *pte &= ~PTE_P;
+          if (++cleared <= INVLPG_MAX)
+            invalidate_page (pd, va);
+        }
+      va += PGSIZE;
+    }
+  if (cleared > INVLPG_MAX)
+    invalidate_pagedir (pd);
+}
+
 /* Returns true if the PTE for virtual page VPAGE in PD is dirty,
    that is, if the page has been modified since the PTE was
    installed.
@@ -181,7 +227,7 @@ pagedir_set_dirty (uint32_t *pd, const void *vpage, bool dirty)
       else 
         {
           *pte &= ~(uint32_t) PTE_D;
-          invalidate_pagedir (pd);
+          invalidate_page (pd, vpage);
         }
     }
 }
@@ -210,7 +256,7 @@ pagedir_set_accessed (uint32_t *pd, const void *vpage, bool accessed)
       else 
         {
           *pte &= ~(uint32_t) PTE_A; 
-          invalidate_pagedir (pd);
+          invalidate_page (pd, vpage);
         }
     }
 }
@@ -262,3 +308,13 @@ invalidate_pagedir (uint32_t *pd)
       pagedir_activate (pd);
     } 
 }
+
+/* Invalidates the TLB entry for VADDR if PD is the active page
+   directory, leaving the rest of the TLB intact.  See [IA32-v2a]
+   "INVLPG--Invalidate TLB Entry". */
+static void
+invalidate_page (uint32_t *pd, const void *vaddr)
+{
+  if (active_pd () == pd)
+    asm volatile ("invlpg (%0)" : : "r" (vaddr) : "memory");
+}
@@ -7,6 +7,7 @@
 #include <string.h>
 #include "userprog/gdt.h"
 #include "userprog/pagedir.h"
+#include "userprog/syscall.h"
 #include "userprog/tss.h"
 #include "filesys/directory.h"
 #include "filesys/file.h"
@@ -22,9 +23,27 @@
 #include "vm/page.h"
 #include "vm/swap.h"
 #include "vm/mapping.h"
+#include "vm/region.h"
+#include "vm/prefetch.h"
+#include "vm/vmstat.h"
 #include "bitmap.h"
 
-#define STACK_SIZE_LIMIT	(1024 * 1024)
+/* Default for stack_page_limit, 1 MB. */
+#define STACK_PAGES_DEFAULT	256
+
+/* Most pages mapped below a stack fault ahead of need.  Every growth
+ maps twice as many as the one before, so deep recursion soon stops
+ faulting page by page. */
+#define STACK_GROW_MAX		16
+
+/* Pages read ahead of, and aged behind, a fault in a MADV_SEQUENTIAL
+ region. */
+#define READAHEAD_PAGES		8
+
+/* Smallest resident set limit.  An instruction can touch several
+ pages, and a process that keeps evicting one to fault in another
+ would never make progress. */
+#define RSS_LIMIT_MIN		16
 
 extern struct lock lock_file_sys;
 
@@ -35,6 +54,11 @@ struct proc_inf
 };
 
 static struct list process_list;
+
+/* Pages a user stack may grow to.  The whole range is set aside for
+ the stack when a process starts. */
+size_t stack_page_limit = STACK_PAGES_DEFAULT;
+
 static thread_func start_process NO_RETURN;
 static bool load (const char *cmdline, void (**eip) (void), void **esp);
 void parser_commands (char *command, int *argc, char *argv[]);
@@ -60,9 +84,21 @@ process_start (void)
 /* Starts a new thread running a user program loaded from
  FILENAME.  The new thread may be scheduled (and may even exit)
  before process_execute() returns.  Returns the new process's
- thread id, or TID_ERROR if the thread cannot be created. */
+ thread id, or TID_ERROR if the thread cannot be created.
+ The new process inherits the caller's resident set limit. */
 tid_t
 process_execute (const char *file_name)
+{
+  struct process *parent = thread_current ()->p;
+  return process_execute_limited (file_name,
+				  parent != NULL ? parent->rss_limit : 0);
+}
+
+/* Like process_execute(), but once the new process has RSS_LIMIT
+ pages resident, its own pages are evicted first to make room for
+ new ones.  0 means no limit. */
+tid_t
+process_execute_limited (const char *file_name, size_t rss_limit)
 {
   struct proc_inf *p_inf = (struct proc_inf*) malloc (sizeof(struct proc_inf));
   if (p_inf == NULL)
@@ -104,10 +140,8 @@ process_execute (const char *file_name)
       return TID_ERROR;
     }
   list_init (p->list_file_desc);
-  list_push_front (&process_list, &p->elem);
 
   // Init page table
-  sema_init (&p->page_table_sema, 1);
   if (!page_table_init (&p->page_table))
     {
       free (p->list_file_desc);
@@ -117,8 +151,20 @@ process_execute (const char *file_name)
       return TID_ERROR;
     }
 
+  // Init region table
+  region_table_init (p);
+
   // Init mapping table
   p->mapping_counter = 0;
+  p->locked_cnt = 0;
+  p->rss = 0;
+  p->ws_cnt = 0;
+  p->rss_limit =
+      (rss_limit != 0 && rss_limit < RSS_LIMIT_MIN) ? RSS_LIMIT_MIN : rss_limit;
+  p->committed = 0;
+  p->oom_killed = false;
+  p->stack_bottom = PHYS_BASE;
+  p->stack_grow = 1;
   lock_init(&p->mapping_table_lock);
   if (!mapping_table_init (&p->mapping_table))
     {
@@ -132,6 +178,10 @@ process_execute (const char *file_name)
 
   p_inf->p = p;
 
+  /* Only now that P is fully set up may the frame allocator, which
+   walks process_list, see it. */
+  list_push_front (&process_list, &p->elem);
+
   /* Create a new thread to execute FILE_NAME. */
   tid_t tid = p->pid = thread_create (file_name, PRI_DEFAULT, start_process,
 				      p_inf);
@@ -313,16 +363,12 @@ process_exit (int status)
   while (!list_empty (cur_process->list_file_desc))
     {
       struct list_elem *e = list_pop_front (cur_process->list_file_desc);
-      free (list_entry(e, struct file_desc, elem));
+      kmem_cache_free (&file_desc_slab, list_entry(e, struct file_desc, elem));
     }
 
   free (cur_process->list_file_desc);
   cur_process->terminated = true;
   cur_process->exit_code = status;
-  if (cur_process->executable != NULL)
-    {
-      file_close (cur_process->executable);
-    }
 
   /* Free and remove from list all terminated children.
    * If parent has been terminated, free and remove this as well */
@@ -352,11 +398,30 @@ process_exit (int status)
 
     }
 
+  /* Unmap the whole user address space with a single TLB flush,
+   rather than one per page as the pages are freed below. */
+  if (cur_thread->pagedir != NULL)
+    {
+      pagedir_clear_pages (cur_thread->pagedir, NULL,
+			   (uintptr_t) PHYS_BASE / PGSIZE);
+    }
+
+  // Stop any prefetching before the address space goes away
+  prefetch_cancel (cur_process);
+
   // Free mapped files
   mapping_table_destroy(cur_process);
 
   // Free this process's page table
   page_table_destroy(cur_process);
+  region_table_destroy(cur_process);
+
+  /* Only close the executable once its pages have left the page cache,
+   which is keyed by its inode. */
+  if (cur_process->executable != NULL)
+    {
+      file_close (cur_process->executable);
+    }
 
   printf ("%s: exit(%d)\n", thread_current ()->name, status);
 
@@ -482,6 +547,7 @@ load (const char *file_name, void (**eip) (void), void **esp)
   struct file *file = NULL;
   off_t file_ofs;
   bool success = false;
+  uint32_t segments_end = 0;
   int i;
 
   /* Allocate and activate page directory. */
@@ -563,6 +629,8 @@ load (const char *file_name, void (**eip) (void), void **esp)
               if (!load_segment (file, file_page, (void *) mem_page,
                                  read_bytes, zero_bytes, writable, true))
                 goto done;
+              if (mem_page + read_bytes + zero_bytes > segments_end)
+                segments_end = mem_page + read_bytes + zero_bytes;
             }
           else
             goto done;
@@ -570,6 +638,9 @@ load (const char *file_name, void (**eip) (void), void **esp)
         }
     }
 
+  /* The heap starts out empty, right after the last segment. */
+  t->p->heap_start = t->p->brk = (void *) segments_end;
+
   /* Set up stack. */
   if (!setup_stack (esp))
     goto done;
@@ -650,8 +721,11 @@ validate_segment (const struct Elf32_Phdr *phdr, struct file *file)
  The pages initialized by this function must be writable by the
  user process if WRITABLE is true, read-only otherwise.
 
+ Nothing is read yet: the segment is recorded as a region and its
+ pages are created on their first fault.
+
  Return true if successful, false if a memory allocation error
- or disk read error occurs. */
+ occurs or the segment overlaps one loaded before. */
 bool
 load_segment (struct file *file, off_t ofs, uint8_t *upage, uint32_t read_bytes,
 	      uint32_t zero_bytes, bool writable, bool read_only)
@@ -659,91 +733,80 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage, uint32_t read_bytes,
   ASSERT((read_bytes + zero_bytes) % PGSIZE == 0);
   ASSERT(ofs % PGSIZE == 0);
 
-  if (pg_ofs (upage) != 0)
+  return region_add (thread_current ()->p, REGION_SEGMENT, upage,
+		     thread_current ()->pagedir, file, ofs, read_bytes,
+		     zero_bytes, writable, read_only);
+}
+
+/* Gives PROC a zeroed stack page at UPAGE, and leaves it checked out
+ if LOCK_IN.  Fails if there already is a page at UPAGE or memory is
+ short. */
+static bool
+stack_add_page (struct process *proc, void *upage, bool lock_in)
+{
+  if (!region_reserve (proc, 1))
     {
       return false;
     }
-
-  struct process *proc = thread_current()->p;
-
-  while (read_bytes > 0 || zero_bytes > 0)
+  struct frame *fr = frame_alloc_and_check_out (true);
+  if (fr == NULL)
     {
-      /* Calculate how to fill this page.
-       We will read PAGE_READ_BYTES bytes from FILE
-       and zero the final PAGE_ZERO_BYTES bytes. */
-      size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
-      size_t page_zero_bytes = PGSIZE - page_read_bytes;
+      region_unreserve (proc, 1);
+      return false;
+    }
 
-      /* Get a page of memory. */
-      struct page *pg = page_alloc_and_check_out (proc, upage,
-						  thread_current ()->pagedir,
-						  PAGE_TYPE_FILE, writable);
-      if (pg == NULL)
-	return false;
+  struct page *pg = page_alloc_and_check_out (proc, upage,
+					      thread_current ()->pagedir,
+					      PAGE_TYPE_ZERO, true);
+  if (pg == NULL)
+    {
+      frame_free (fr);
+      region_unreserve (proc, 1);
+      return false;
+    }
 
-      if (page_read_bytes == 0)
-	{
-	  pg->type = PAGE_TYPE_ZERO;
-	}
-      else
-	{
-	  // Store page info
-	  pg->ps.fs.f = file;
-	  pg->ps.fs.size = page_read_bytes;
-	  pg->ps.fs.offset = ofs;
-	  pg->ps.fs.read_only = read_only;
-	}
+  if (!install_page (fr, pg, true))
+    {
       page_check_in (proc, upage);
-
-      /* Advance. */
-      read_bytes -= page_read_bytes;
-      zero_bytes -= page_zero_bytes;
-      upage += PGSIZE;
-      ofs += page_read_bytes;
+      page_free (proc, upage);
+      frame_free (fr);
+      region_unreserve (proc, 1);
+      return false;
     }
+  frame_check_in (fr);
+  if (!lock_in)
+    {
+      page_check_in (proc, upage);
+    }
+  if (upage < proc->stack_bottom)
+    {
+      proc->stack_bottom = upage;
+    }
+  VMSTAT_INC(stack_growths);
+  VMSTAT_INC(zero_fills);
   return true;
 }
 
-/* Create a minimal stack by mapping a zeroed page at the top of
- user virtual memory. */
+/* Sets aside the top stack_page_limit pages of user virtual memory for
+ the stack and maps a zeroed page at the very top. */
 static bool
 setup_stack (void **esp)
 {
-  uint8_t *upage = ((uint8_t*) PHYS_BASE) - PGSIZE;
-
-  struct frame *f = frame_alloc_and_check_out (true);
-
-  ASSERT(f != NULL);
-
-  void *kaddr = f->kernel_address;
-
   struct process *proc = thread_current()->p;
 
-  struct page *pg = page_alloc_and_check_out (proc, upage, thread_current ()->pagedir,
-					      PAGE_TYPE_ZERO, true);
-
-  if (pg == NULL)
+  if (!region_add (proc, REGION_STACK, PHYS_BASE - stack_page_limit * PGSIZE,
+		   thread_current ()->pagedir, NULL, 0, 0,
+		   stack_page_limit * PGSIZE, true, false))
     {
-      frame_check_in (kaddr);
-      frame_free (kaddr, true);
       return false;
     }
 
-  if (install_page (f, pg, true))
+  if (!stack_add_page (proc, PHYS_BASE - PGSIZE, false))
     {
-      page_check_in (proc, upage);
-      frame_check_in (kaddr);
-      *esp = PHYS_BASE;
-      return true;
-    }
-  else
-    {
-      page_check_in (proc, upage);
-      frame_check_in (kaddr);
-      page_free (proc, upage);
-      frame_free (kaddr, true);
       return false;
     }
+  *esp = PHYS_BASE;
+  return true;
 }
 
 /* Adds a mapping from user virtual address UPAGE to kernel
@@ -758,7 +821,7 @@ setup_stack (void **esp)
 bool
 install_page (struct frame *f, struct page *p, bool writable)
 {
-  struct thread *t = thread_current ();
+  uint32_t *pd = p->pagedir;
 
   void *upage = p->user_address;
   void *kpage = f->kernel_address;
@@ -766,134 +829,405 @@ install_page (struct frame *f, struct page *p, bool writable)
   /* Verify that there's not already a page at that virtual
    address, then map our page there. */
 
-  if (pagedir_get_page (t->pagedir, upage) == NULL
-      && pagedir_set_page (t->pagedir, upage, kpage, writable))
+  if (pagedir_get_page (pd, upage) == NULL
+      && pagedir_set_page (pd, upage, kpage, writable))
     {
-      f->user_page = p;
-      p->f = f;
+      frame_attach (f, p);
       return true;
     }
   return false;
 }
 
+/* Gives PROC an untouched stack page at UPAGE, without a frame.  Like
+ any zero page, it gets one on its first write, and reads of it see the
+ zero frame.  Fails if there already is a page at UPAGE or swap cannot
+ be reserved for it. */
+static bool
+stack_add_lazy_page (struct process *proc, void *upage)
+{
+  if (!region_reserve (proc, 1))
+    {
+      return false;
+    }
+  struct page *pg = page_alloc_and_check_out (proc, upage,
+					      thread_current ()->pagedir,
+					      PAGE_TYPE_ZERO, true);
+  if (pg == NULL)
+    {
+      region_unreserve (proc, 1);
+      return false;
+    }
+  page_check_in (proc, upage);
+  if (upage < proc->stack_bottom)
+    {
+      proc->stack_bottom = upage;
+    }
+  VMSTAT_INC(stack_growths);
+  return true;
+}
+
+/* Grows the stack to cover FAULT_ADDR, if it is within the stack's
+ reserved range and no more than 32 bytes below ESP, as PUSHA may
+ write.  Pages skipped over since the last growth, by a large frame
+ for example, are added along with it, and so are the next stack_grow
+ pages below.  Those get no frame until they are touched, and faulting
+ on them no longer goes through the stack heuristics.  stack_grow
+ doubles while each fault lands right below the last growth, as in
+ deepening recursion, and drops back to 1 as soon as one does not. */
 bool
 grow_stack (const void *fault_addr, void *esp, bool lock_in)
 {
   void *uaddr = pg_round_down (fault_addr);
-  if ((PHYS_BASE <= uaddr + STACK_SIZE_LIMIT) && (esp <= fault_addr + 32))
+  void *limit = PHYS_BASE - stack_page_limit * PGSIZE;
+  struct process *proc = thread_current ()->p;
+  bool consecutive = uaddr == proc->stack_bottom - PGSIZE;
+  if (uaddr < limit || esp > fault_addr + 32
+      || !stack_add_page (proc, uaddr, lock_in))
     {
-      // Grow stack
-      struct frame *fr = frame_alloc_and_check_out (true);
-      ASSERT(fr != NULL);
-      void *kaddr = fr->kernel_address;
-
-      struct process *proc = thread_current()->p;
+      return false;
+    }
+  VMSTAT_INC(minor_faults);
+  if (!consecutive)
+    {
+      proc->stack_grow = 1;
+    }
 
-      struct page *pg = page_alloc_and_check_out (proc, uaddr,
-						  thread_current ()->pagedir,
-						  PAGE_TYPE_ZERO, true);
-      if (pg == NULL)
+  if (uaddr != proc->stack_bottom)
+    {
+      // Not below the stack, as after a page of it was freed
+      return true;
+    }
+  void *upage;
+  for (upage = uaddr + PGSIZE; upage < PHYS_BASE; upage += PGSIZE)
+    {
+      if (pagedir_get_page (thread_current ()->pagedir, upage) != NULL
+	  || !stack_add_lazy_page (proc, upage))
 	{
-	  frame_check_in (kaddr);
-	  frame_free (kaddr, true);
-	  return false;
+	  break;
+	}
+    }
+  size_t ahead = proc->stack_grow;
+  if (ahead > (size_t) (uaddr - limit) / PGSIZE)
+    {
+      ahead = (uaddr - limit) / PGSIZE;
+    }
+  for (size_t i = 1; i <= ahead; i++)
+    {
+      if (!stack_add_lazy_page (proc, uaddr - i * PGSIZE))
+	{
+	  break;
 	}
+    }
+  if (proc->stack_grow < STACK_GROW_MAX)
+    {
+      proc->stack_grow *= 2;
+    }
+  return true;
+}
 
-      if (install_page (fr, pg, true))
+static bool
+do_load_page (struct process *proc, void *upage, bool write, bool lock_in,
+	      bool *major);
+
+/* Brings the page containing FAULT_ADDR into memory.  Faults in a
+ MADV_SEQUENTIAL region also start reading the following pages and let
+ the clock reclaim the ones the scan has moved past. */
+bool
+retrieve_page (const void *fault_addr, bool write, bool lock_in)
+{
+  ASSERT(is_user_vaddr (fault_addr));
+  struct thread *t = thread_current ();
+  void *uaddr = pg_round_down (fault_addr);
+  bool miss = pagedir_get_page (t->pagedir, uaddr) == NULL;
+  bool major;
+  if (!do_load_page (t->p, uaddr, write, lock_in, &major))
+    {
+      return false;
+    }
+  if (major)
+    {
+      VMSTAT_INC(major_faults);
+    }
+  else
+    {
+      VMSTAT_INC(minor_faults);
+    }
+  void *end;
+  if (miss && region_advice (t->p, uaddr, &end) == MADV_SEQUENTIAL)
+    {
+      size_t page_cnt = (end - uaddr) / PGSIZE - 1;
+      if (page_cnt > READAHEAD_PAGES)
 	{
-	  if (!lock_in)
-	    {
-	      page_check_in (proc, uaddr);
-	    }
-	  frame_check_in (kaddr);
-	  return true;
+	  page_cnt = READAHEAD_PAGES;
 	}
-      else
+      prefetch_queue (t->p, uaddr + PGSIZE, page_cnt);
+      if (uaddr >= (void*) (2 * READAHEAD_PAGES * PGSIZE))
 	{
-	  page_check_in (proc, uaddr);
-	  frame_check_in (kaddr);
-	  page_free (proc, uaddr);
-	  frame_free (kaddr, true);
-	  return false;
+	  for (int i = READAHEAD_PAGES + 1; i <= 2 * READAHEAD_PAGES; i++)
+	    {
+	      pagedir_set_accessed (t->pagedir, uaddr - i * PGSIZE, false);
+	    }
 	}
     }
-  return false;
+  return true;
 }
 
+/* Brings page UPAGE of PROC into memory.  Reads of untouched zero pages
+ map the shared zero frame read-only; the first WRITE replaces it with
+ a private frame. */
 bool
-retrieve_page (const void *fault_addr, bool lock_in)
+load_page (struct process *proc, void *upage, bool write, bool lock_in)
 {
-  ASSERT(is_user_vaddr (fault_addr));
-  void *uaddr = pg_round_down (fault_addr);
-  struct frame *fr = frame_alloc_and_check_out (false);
-  ASSERT(fr != NULL);
-  void *kaddr = fr->kernel_address;
-  struct process *proc = thread_current()->p;
-  struct page *p = page_check_out (proc, uaddr, false);
+  bool major;
+  return do_load_page (proc, upage, write, lock_in, &major);
+}
+
+/* Does the work of load_page(), and sets *MAJOR if the page had to be
+ read from a file or swap. */
+static bool
+do_load_page (struct process *proc, void *upage, bool write, bool lock_in,
+	      bool *major)
+{
+  ASSERT(is_user_vaddr (upage));
+  ASSERT(pg_ofs (upage) == 0);
+  *major = false;
+  void *uaddr = upage;
+  struct page *p = region_page_check_out (proc, uaddr);
   if (p == NULL)
     {
-      frame_check_in (kaddr);
-      frame_free (kaddr, true);
       return false;
     }
   if (p->f != NULL)
     {
-      if (!lock_in)
+      if (!write || !p->writable || !frame_is_zero (p->f))
 	{
+	  if (!lock_in || (write && !p->writable))
+	    {
+	      page_check_in (proc, uaddr);
+	    }
+	  return !write || p->writable;
+	}
+      // First write to a zero page, give it a frame of its own
+      pagedir_clear_page (p->pagedir, uaddr);
+      frame_release (p->f, p);
+    }
+  else if (p->type == PAGE_TYPE_ZERO && !write)
+    {
+      if (pagedir_set_page (p->pagedir, uaddr, frame_zero ()->kernel_address,
+			    false))
+	{
+	  p->f = frame_zero ();
+	  if (!lock_in)
+	    {
+	      page_check_in (proc, uaddr);
+	    }
+	  return true;
+	}
+      page_check_in (proc, uaddr);
+      return false;
+    }
+  /* Read-only file pages and file mappings are shared with other
+   processes via the page cache.  Writable segment pages go to swap once
+   dirtied, so they stay private. */
+  struct inode *inode = NULL;
+  struct frame *fr = NULL;
+  bool shared_write = p->type == PAGE_TYPE_FILE && !p->ps.fs.read_only;
+  if (p->type == PAGE_TYPE_FILE && (!p->writable || shared_write))
+    {
+      inode = file_get_inode (p->ps.fs.f);
+      bool busy;
+      fr = frame_cache_check_out (inode, p->ps.fs.offset, p->ps.fs.size,
+				  shared_write, &busy);
+      if (busy)
+	{
+	  // Never wait for a frame while holding a page of our own
+	  off_t offset = p->ps.fs.offset;
 	  page_check_in (proc, uaddr);
+	  frame_cache_wait (inode, offset, shared_write);
+	  return do_load_page (proc, upage, write, lock_in, major);
+	}
+      if (fr != NULL)
+	{
+	  VMSTAT_INC(cache_hits);
 	}
-      frame_check_in (kaddr);
-      frame_free (kaddr, true);
-      return true;
     }
-  // Try to load page from disk
-  switch (p->type)
-    {
-    case PAGE_TYPE_FILE:
-      {
-	lock_acquire (&lock_file_sys);
-	off_t read_size = file_read_at (p->ps.fs.f, kaddr, p->ps.fs.size,
-					p->ps.fs.offset);
-	lock_release (&lock_file_sys);
-	ASSERT(read_size == p->ps.fs.size);
-	if (p->ps.fs.size < PGSIZE)
+  if (fr == NULL)
+    {
+      fr = frame_alloc_and_check_out (false);
+      if (fr == NULL)
+	{
+	  page_check_in (proc, uaddr);
+	  return false;
+	}
+      void *kaddr = fr->kernel_address;
+      // Try to load page from disk
+      switch (p->type)
+	{
+	case PAGE_TYPE_FILE:
+	  {
+	    lock_acquire (&lock_file_sys);
+	    off_t read_size = file_read_at (p->ps.fs.f, kaddr, p->ps.fs.size,
+					    p->ps.fs.offset);
+	    lock_release (&lock_file_sys);
+	    ASSERT(read_size == p->ps.fs.size);
+	    if (p->ps.fs.size < PGSIZE)
+	      {
+		memset ((uint8_t*) kaddr + p->ps.fs.size, 0,
+		PGSIZE - p->ps.fs.size);
+	      }
+	    VMSTAT_INC(file_fills);
+	    *major = true;
+	    break;
+	  }
+	case PAGE_TYPE_SWAP:
+	  {
+	    swap_read (p->ps.swap_sector, kaddr);
+	    p->ps.swap_sector = BITMAP_ERROR;
+	    VMSTAT_INC(swap_fills);
+	    *major = true;
+	    break;
+	  }
+	case PAGE_TYPE_ZERO:
+	  {
+	    memset (kaddr, 0, PGSIZE);
+	    VMSTAT_INC(zero_fills);
+	    break;
+	  }
+	default:
 	  {
-	    memset ((uint8_t*) kaddr + p->ps.fs.size, 0,
-	    PGSIZE - p->ps.fs.size);
+	    ASSERT(false);
 	  }
-	break;
-      }
-    case PAGE_TYPE_SWAP:
-      {
-	swap_read (p->ps.swap_sector, kaddr);
-	p->ps.swap_sector = BITMAP_ERROR;
-	break;
-      }
-    case PAGE_TYPE_ZERO:
-      {
-	memset (kaddr, 0, PGSIZE);
-	break;
-      }
-    default:
-      {
-	ASSERT(false);
-      }
+	}
+      if (inode != NULL
+	  && !frame_cache_insert (fr, inode, p->ps.fs.offset, p->ps.fs.size,
+				  shared_write) && shared_write)
+	{
+	  // A private copy of shared data would diverge, use theirs
+	  frame_free (fr);
+	  page_check_in (proc, uaddr);
+	  return do_load_page (proc, upage, write, lock_in, major);
+	}
     }
   if (install_page (fr, p, p->writable))
     {
+      frame_check_in (fr);
       if (!lock_in)
 	{
 	  page_check_in (proc, uaddr);
 	}
-      frame_check_in (kaddr);
       return true;
     }
   else
     {
+      if (list_empty (&fr->user_pages))
+	{
+	  frame_free (fr);
+	}
+      else
+	{
+	  frame_check_in (fr);
+	}
       page_check_in (proc, uaddr);
-      frame_check_in (kaddr);
-      frame_free (kaddr, true);
       return false;
     }
 }
 
+/* Adjusts PROC's resident set size by RSS pages and its working set
+ estimate by WS pages.  Called by the frame table, which does not hold
+ any per-process lock. */
+void
+process_rss_add (struct process *proc, int rss, int ws)
+{
+  ASSERT(proc != NULL);
+  enum intr_level old_level = intr_disable ();
+  proc->rss += rss;
+  proc->ws_cnt += ws;
+  intr_set_level (old_level);
+}
+
+/* Returns true if PROC has reached its resident set limit. */
+bool
+process_over_rss_limit (const struct process *proc)
+{
+  return proc->rss_limit != 0 && proc->rss >= proc->rss_limit;
+}
+
+/* Returns the live process with the most resident pages outside its
+ working set, or NULL if no process has idle pages. */
+struct process*
+process_idlest (void)
+{
+  struct process *idlest = NULL;
+  size_t most_idle = 0;
+  struct list_elem *e;
+  enum intr_level old_level = intr_disable ();
+  for (e = list_begin (&process_list); e != list_end (&process_list);
+      e = list_next (e))
+    {
+      struct process *p = list_entry(e, struct process, elem);
+      if (!p->terminated && p->rss > p->ws_cnt
+	  && p->rss - p->ws_cnt > most_idle)
+	{
+	  idlest = p;
+	  most_idle = p->rss - p->ws_cnt;
+	}
+    }
+  intr_set_level (old_level);
+  return idlest;
+}
+
+/* Called when PROC cannot get a frame because memory and swap are both
+ full.  Picks a process to kill: PROC itself under OOM_FAIL, or the
+ live process with the most resident pages under OOM_KILL.  Returns
+ true if PROC is the one and should fail its allocation, false if PROC
+ should wait for another process, which may already have been chosen,
+ to exit and free its memory. */
+bool
+process_oom_kill (struct process *proc)
+{
+  ASSERT(proc != NULL);
+  if (proc->oom_killed)
+    {
+      return true;
+    }
+  struct process *victim = proc;
+  enum intr_level old_level = intr_disable ();
+  if (oom_policy == OOM_KILL)
+    {
+      struct list_elem *e;
+      for (e = list_begin (&process_list); e != list_end (&process_list);
+	  e = list_next (e))
+	{
+	  struct process *p = list_entry(e, struct process, elem);
+	  if (p->terminated)
+	    {
+	      continue;
+	    }
+	  if (p->oom_killed)
+	    {
+	      victim = NULL;
+	      break;
+	    }
+	  if (p->rss > victim->rss)
+	    {
+	      victim = p;
+	    }
+	}
+    }
+  if (victim != NULL)
+    {
+      victim->oom_killed = true;
+      VMSTAT_INC(oom_kills);
+    }
+  intr_set_level (old_level);
+  return victim == proc;
+}
+
+/* Returns true if the running thread belongs to a process picked by the
+ OOM killer, which must exit rather than return to user mode. */
+bool
+process_oom_killed (void)
+{
+  struct process *p = thread_current ()->p;
+  return p != NULL && p->oom_killed;
+}
@@ -34,16 +34,39 @@ struct process
   int fd_counter;
   struct file *executable;
   bool terminated;
-  struct hash *page_table;
-  struct semaphore page_table_sema;
+  struct page_table *page_table;
   mapid_t mapping_counter;
   struct hash *mapping_table;
   struct lock mapping_table_lock;
+  struct region *region_root; /* Tree of regions by start address */
+  struct lock region_lock;
+  void *heap_start; /* First page after the executable's segments */
+  void *brk; /* Current program break */
+  size_t locked_cnt; /* Pages locked with mlock() */
+  void *syscall_esp; /* User stack pointer at the last system call */
+  size_t rss; /* Pages with a frame of their own */
+  size_t ws_cnt; /* Resident pages accessed at their last clock visit */
+  size_t rss_limit; /* Most resident pages before eviction turns on
+   this process first, 0 for no limit */
+  size_t committed; /* Anonymous pages reserved in swap */
+  bool oom_killed; /* Chosen to free memory, exits before running again */
+  void *stack_bottom; /* Lowest stack page mapped so far */
+  size_t stack_grow; /* Stack pages to map ahead at the next growth */
 };
 
+/* Most pages stack_page_limit may be, 256 MB.  Keeps the stack region
+ clear of the heap and of the addresses user programs map files and
+ anonymous memory at. */
+#define STACK_PAGES_MAX 65536
+
+extern size_t stack_page_limit;
+
 tid_t
 process_execute (const char *file_name);
 
+tid_t
+process_execute_limited (const char *file_name, size_t rss_limit);
+
 int
 process_wait (tid_t);
 
@@ -63,7 +86,25 @@ bool
 grow_stack (const void *fault_addr, void *esp, bool lock_in);
 
 bool
-retrieve_page (const void *fault_addr, bool lock_in);
+retrieve_page (const void *fault_addr, bool write, bool lock_in);
+
+bool
+load_page (struct process *proc, void *upage, bool write, bool lock_in);
+
+void
+process_rss_add (struct process *proc, int rss, int ws);
+
+bool
+process_over_rss_limit (const struct process *proc);
+
+struct process*
+process_idlest (void);
+
+bool
+process_oom_kill (struct process *proc);
+
+bool
+process_oom_killed (void);
 
 bool
 load_segment (struct file *file, off_t ofs, uint8_t *upage, uint32_t read_bytes,
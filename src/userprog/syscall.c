@@ -12,10 +12,14 @@
 #include "threads/malloc.h"
 #include "devices/input.h"
 #include "vm/mapping.h"
-
-#define MIN(A, B)	(((A) < (B)) ? (A) : (B))
+#include "vm/frame.h"
+#include "vm/region.h"
+#include "vm/vmstat.h"
+#include "userprog/uaccess.h"
+#include "threads/palloc.h"
 
 struct lock lock_file_sys;
+struct kmem_cache file_desc_slab;
 
 static void
 syscall_handler (struct intr_frame*);
@@ -24,15 +28,11 @@ void
 syscall_init (void)
 {
   lock_init (&lock_file_sys);
+  kmem_cache_init (&file_desc_slab, "file_desc", sizeof(struct file_desc),
+		   NULL);
   intr_register_int (0x30, 3, INTR_ON, syscall_handler, "syscall");
 }
 
-static inline void*
-next_page (void *addr)
-{
-  return pg_round_down (addr) + PGSIZE;
-}
-
 static void
 terminate_process (struct intr_frame *f, int status)
 {
@@ -40,57 +40,148 @@ terminate_process (struct intr_frame *f, int status)
   thread_exit (status);
 }
 
-static void*
-get_kernel_address (struct intr_frame *f, uint32_t *pd, void *user_address,
-		    bool writable)
+/* Returns the word at user address USER_SP, terminating the process
+ if it cannot be read. */
+static uint32_t
+get_user_word (struct intr_frame *f, const uint32_t *user_sp)
 {
-  if ((f == NULL) || (pd == NULL) || (user_address == NULL)
-      || !is_user_vaddr (user_address))
+  uint32_t word;
+  if (!copy_from_user (&word, user_sp, sizeof word))
     {
-      goto error;
+      terminate_process (f, -1);
     }
+  return word;
+}
 
-  void *upage = pg_round_down (user_address);
-  void *ret_addr = NULL;
-
-  struct process *proc = thread_current ()->p;
-
-  page_check_out (proc, upage, false);
-
-  ret_addr = pagedir_get_page (pd, user_address);
+/* Returns a page holding a copy of the string at user address USTR,
+ to be freed with palloc_free_page().  Terminates the process if the
+ string cannot be read or is longer than a page.  Callers fetch their
+ other arguments first, as a failed get_user_word() would leak the
+ page. */
+static char*
+copy_in_string (struct intr_frame *f, const char *ustr)
+{
+  char *kstr = palloc_get_page (0);
+  if (kstr == NULL)
+    {
+      terminate_process (f, -1);
+    }
+  if (!copy_string_from_user (kstr, ustr, PGSIZE))
+    {
+      palloc_free_page (kstr);
+      terminate_process (f, -1);
+    }
+  return kstr;
+}
 
-  if (ret_addr == NULL)
+/* Returns the open file FD of PROC, or NULL if there is none. */
+static struct file_desc*
+lookup_fd (struct process *proc, int fd)
+{
+  struct list_elem *e;
+  for (e = list_begin (proc->list_file_desc);
+      e != list_end (proc->list_file_desc); e = list_next (e))
     {
-      page_check_in (proc, upage);
-      if (retrieve_page (user_address, true))
+      struct file_desc *fl = list_entry(e, struct file_desc, elem);
+      if (fl->fd == fd)
 	{
-	  ret_addr = pagedir_get_page (pd, user_address);
+	  return fl;
 	}
-      else if (grow_stack (user_address, f->esp, true))
+    }
+  return NULL;
+}
+
+/* Reads up to SIZE bytes from FL, or from the keyboard if FL is NULL,
+ into user memory at UBUF and returns how many were read.  Data is
+ staged through a kernel page one chunk at a time.  The file system
+ never touches user memory under lock_file_sys, and no user frames need
+ pinning however big the buffer is.  Terminates the process if UBUF is
+ not writable. */
+static unsigned
+read_to_user (struct intr_frame *f, struct file_desc *fl, uint8_t *ubuf,
+	      unsigned size)
+{
+  uint8_t *kbuf = palloc_get_page (0);
+  if (kbuf == NULL)
+    {
+      terminate_process (f, -1);
+    }
+  unsigned done = 0;
+  while (done < size)
+    {
+      unsigned chunk = size - done < PGSIZE ? size - done : PGSIZE;
+      unsigned n;
+      if (fl == NULL)
 	{
-	  ret_addr = pagedir_get_page (pd, user_address);
+	  for (n = 0; n < chunk; n++)
+	    {
+	      kbuf[n] = input_getc ();
+	    }
 	}
       else
 	{
-	  goto error;
+	  lock_acquire (&lock_file_sys);
+	  n = file_read_at (fl->f, kbuf, chunk, fl->pos);
+	  lock_release (&lock_file_sys);
+	  fl->pos += n;
+	}
+      if (!copy_to_user (ubuf + done, kbuf, n))
+	{
+	  palloc_free_page (kbuf);
+	  terminate_process (f, -1);
+	}
+      done += n;
+      if (n < chunk)
+	{
+	  break;
 	}
     }
+  palloc_free_page (kbuf);
+  return done;
+}
 
-  if (writable && !page_is_writable (proc, upage))
+/* Writes up to SIZE bytes from user memory at UBUF to FL, or to the
+ console if FL is NULL, and returns how many were written.  Staged a
+ chunk at a time like read_to_user().  Terminates the process if UBUF
+ is not readable. */
+static unsigned
+write_from_user (struct intr_frame *f, struct file_desc *fl,
+		 const uint8_t *ubuf, unsigned size)
+{
+  uint8_t *kbuf = palloc_get_page (0);
+  if (kbuf == NULL)
     {
-      page_check_in (proc, upage);
-      goto error;
+      terminate_process (f, -1);
     }
-
-  pagedir_set_accessed (pd, user_address, true);
-  if (writable)
+  unsigned done = 0;
+  while (done < size)
     {
-      pagedir_set_dirty (pd, user_address, true);
+      unsigned chunk = size - done < PGSIZE ? size - done : PGSIZE;
+      unsigned n = chunk;
+      if (!copy_from_user (kbuf, ubuf + done, chunk))
+	{
+	  palloc_free_page (kbuf);
+	  terminate_process (f, -1);
+	}
+      if (fl == NULL)
+	{
+	  putbuf ((const char*) kbuf, chunk);
+	}
+      else
+	{
+	  lock_acquire (&lock_file_sys);
+	  n = file_write_at (fl->f, kbuf, chunk, fl->pos);
+	  lock_release (&lock_file_sys);
+	  fl->pos += n;
+	}
+      done += n;
+      if (n < chunk)
+	{
+	  break;
+	}
     }
-
-  return ret_addr;
-error: terminate_process (f, -1);
-  return NULL;
+  palloc_free_page (kbuf);
+  return done;
 }
 
 static void
@@ -98,15 +189,19 @@ syscall_handler (struct intr_frame *f)
 {
 
   struct thread *cur_thread = thread_current ();
-  uint32_t *pd = cur_thread->pagedir;
   struct process *cur_proc = cur_thread->p;
 
   uint32_t *user_sp = f->esp;
-  uint32_t *sp = get_kernel_address (f, pd, user_sp, false);
+  cur_proc->syscall_esp = f->esp;
 
-  uint32_t syscall_nr = *sp;
+  // Picked by the OOM killer while running
+  if (cur_proc->oom_killed)
+    {
+      terminate_process (f, -1);
+      return;
+    }
 
-  page_check_in (cur_proc, pg_round_down (user_sp));
+  uint32_t syscall_nr = get_user_word (f, user_sp);
 
   switch (syscall_nr)
     {
@@ -117,83 +212,80 @@ syscall_handler (struct intr_frame *f)
       }
     case SYS_EXIT:
       {
-	user_sp++;
-	sp = get_kernel_address (f, pd, user_sp, false);
-	int status = *(int*) sp;
-	page_check_in (cur_proc, pg_round_down (user_sp));
+	int status = get_user_word (f, ++user_sp);
 	terminate_process (f, status);
 	break;
       }
     case SYS_EXEC:
       {
-	user_sp++;
-	sp = get_kernel_address (f, pd, user_sp, false);
-	page_check_in (cur_proc, pg_round_down (user_sp));
-	char *cmd_line = get_kernel_address (f, pd, *(char**) sp, false);
+	char *cmd_line = copy_in_string (
+	    f, (const char*) get_user_word (f, ++user_sp));
 	lock_acquire (&lock_file_sys);
 	f->eax = process_execute (cmd_line);
 	lock_release (&lock_file_sys);
-	page_check_in (cur_proc, pg_round_down (*(char**) sp));
+	palloc_free_page (cmd_line);
+	break;
+      }
+    case SYS_EXEC_RSS:
+      {
+	const char *ucmd_line = (const char*) get_user_word (f, ++user_sp);
+	size_t max_pages = get_user_word (f, ++user_sp);
+	char *cmd_line = copy_in_string (f, ucmd_line);
+	lock_acquire (&lock_file_sys);
+	f->eax = process_execute_limited (cmd_line, max_pages);
+	lock_release (&lock_file_sys);
+	palloc_free_page (cmd_line);
 	break;
       }
     case SYS_WAIT:
       {
-	user_sp++;
-	sp = get_kernel_address (f, pd, user_sp, false);
-	pid_t pid = *(pid_t*) sp;
+	pid_t pid = get_user_word (f, ++user_sp);
 	f->eax = process_wait (pid);
-	page_check_in (cur_proc, pg_round_down (user_sp));
 	break;
       }
     case SYS_CREATE:
       {
-	user_sp++;
-	sp = get_kernel_address (f, pd, user_sp, false);
-	page_check_in (cur_proc, pg_round_down (user_sp));
-	char *file = get_kernel_address (f, pd, *(char**) sp, false);
-	user_sp++;
-	page_check_in (cur_proc, pg_round_down (*(char**) sp));
-	sp = get_kernel_address (f, pd, user_sp, false);
-	unsigned size = *(unsigned*) sp;
+	const char *ufile = (const char*) get_user_word (f, ++user_sp);
+	unsigned size = get_user_word (f, ++user_sp);
+	char *file = copy_in_string (f, ufile);
 	lock_acquire (&lock_file_sys);
 	f->eax = filesys_create (file, size);
 	lock_release (&lock_file_sys);
-	page_check_in (cur_proc, pg_round_down (user_sp));
+	palloc_free_page (file);
 	break;
       }
     case SYS_REMOVE:
       {
-	user_sp++;
-	sp = get_kernel_address (f, pd, user_sp, false);
-	char *file = get_kernel_address (f, pd, *(char**) sp, false);
+	char *file = copy_in_string (
+	    f, (const char*) get_user_word (f, ++user_sp));
 	lock_acquire (&lock_file_sys);
 	f->eax = filesys_remove (file);
 	lock_release (&lock_file_sys);
-	page_check_in (cur_proc, pg_round_down (user_sp));
-	page_check_in (cur_proc, pg_round_down (*(char**) sp));
+	palloc_free_page (file);
 	break;
       }
     case SYS_OPEN:
       {
-	user_sp++;
-	sp = get_kernel_address (f, pd, user_sp, false);
-	page_check_in (cur_proc, pg_round_down (user_sp));
-	char *file = get_kernel_address (f, pd, *(char**) sp, false);
+	char *file = copy_in_string (
+	    f, (const char*) get_user_word (f, ++user_sp));
 	lock_acquire (&lock_file_sys);
 	struct file *fl = filesys_open (file);
 	lock_release (&lock_file_sys);
+	palloc_free_page (file);
 	if (fl == NULL)
 	  {
 	    f->eax = -1;
 	  }
 	else
 	  {
-	    struct file_desc *fd = (struct file_desc*) malloc (
-		sizeof(struct file_desc));
+	    struct file_desc *fd = (struct file_desc*) kmem_cache_alloc (
+		&file_desc_slab);
 	    if (fd == NULL)
 	      {
+		lock_acquire (&lock_file_sys);
+		file_close (fl);
+		lock_release (&lock_file_sys);
 		f->eax = -1;
-		page_check_in (cur_proc, pg_round_down (*(char**) sp));
 		return;
 	      }
 	    fd->f = fl;
@@ -202,369 +294,215 @@ syscall_handler (struct intr_frame *f)
 	    list_push_front (cur_proc->list_file_desc, &fd->elem);
 	    f->eax = fd->fd;
 	  }
-	page_check_in (cur_proc, pg_round_down (*(char**) sp));
 	break;
       }
     case SYS_FILESIZE:
       {
-	user_sp++;
-	sp = get_kernel_address (f, pd, user_sp, false);
-	int fd = *(int*) sp;
-
-	struct list_elem *e;
-	for (e = list_begin (cur_proc->list_file_desc);
-	    e != list_end (cur_proc->list_file_desc); e = list_next (e))
+	int fd = get_user_word (f, ++user_sp);
+	struct file_desc *fl = lookup_fd (cur_proc, fd);
+	if (fl == NULL)
 	  {
-	    struct file_desc *fl = list_entry(e, struct file_desc, elem);
-	    if (fl->fd == fd)
-	      {
-		lock_acquire (&lock_file_sys);
-		f->eax = file_length (fl->f);
-		lock_release (&lock_file_sys);
-		page_check_in (cur_proc, pg_round_down (user_sp));
-		return;
-	      }
+	    f->eax = -1;
+	    return;
 	  }
-	f->eax = -1;
-	page_check_in (cur_proc, pg_round_down (user_sp));
+	lock_acquire (&lock_file_sys);
+	f->eax = file_length (fl->f);
+	lock_release (&lock_file_sys);
 	break;
       }
     case SYS_READ:
       {
-	user_sp++;
-	sp = get_kernel_address (f, pd, user_sp, false);
-	int fd = *(int*) sp;
-	page_check_in (cur_proc, pg_round_down (user_sp));
-	user_sp++;
-	sp = get_kernel_address (f, pd, user_sp, false);
-	uint8_t *user_buffer = *(uint8_t**) sp;
+	int fd = get_user_word (f, ++user_sp);
+	uint8_t *user_buffer = (uint8_t*) get_user_word (f, ++user_sp);
+	unsigned size = get_user_word (f, ++user_sp);
 	if (user_buffer == NULL)
 	  {
-	    page_check_in (cur_proc, pg_round_down (user_sp));
 	    terminate_process (f, -1);
 	    return;
 	  }
-	page_check_in (cur_proc, pg_round_down (user_sp));
-	user_sp++;
-	sp = get_kernel_address (f, pd, user_sp, false);
-	unsigned size = *(unsigned*) sp;
-	page_check_in (cur_proc, pg_round_down (user_sp));
-	if (fd == 0)
-	  {
-	    int32_t rem_size = size;
-	    unsigned chunk_idx = 0;
-	    do
-	      {
-		uint8_t *kernel_buffer = get_kernel_address (
-		    f, pd, user_buffer + chunk_idx, true);
-
-		unsigned chunk_sz = MIN(
-		    rem_size,
-		    (uint8_t* )next_page (kernel_buffer) - kernel_buffer);
-
-		for (unsigned i = 0; i < chunk_sz; i++)
-		  {
-		    kernel_buffer[i] = input_getc ();
-		  }
-		page_check_in (cur_proc,
-			       pg_round_down (user_buffer + chunk_idx));
-		rem_size -= chunk_sz;
-		chunk_idx += chunk_sz;
-	      }
-	    while (rem_size > 0);
-	    f->eax = size;
-
-	    return;
-	  }
-	else if (fd == 1)
+	struct file_desc *fl = NULL;
+	if (fd != 0)
 	  {
-	    f->eax = -1;
-
-	    return;
-	  }
-	else
-	  {
-	    struct list_elem *e;
-	    for (e = list_begin (cur_proc->list_file_desc);
-		e != list_end (cur_proc->list_file_desc); e = list_next (e))
+	    fl = fd == 1 ? NULL : lookup_fd (cur_proc, fd);
+	    if (fl == NULL)
 	      {
-		struct file_desc *fl = list_entry(e, struct file_desc, elem);
-		if (fl->fd == fd)
-		  {
-		    lock_acquire (&lock_file_sys);
-
-		    int32_t rem_size = size;
-		    unsigned chunk_idx = 0;
-		    f->eax = 0;
-		    do
-		      {
-			uint8_t *kernel_buffer = get_kernel_address (
-			    f, pd, user_buffer + chunk_idx, true);
-			unsigned chunk_sz = MIN(
-			    rem_size,
-			    (uint8_t* )next_page (kernel_buffer)
-				- kernel_buffer);
-			off_t sz = file_read_at (fl->f, kernel_buffer, chunk_sz,
-						 fl->pos);
-			f->eax += sz;
-			fl->pos += sz;
-			page_check_in (cur_proc,
-				       pg_round_down (user_buffer + chunk_idx));
-			rem_size -= chunk_sz;
-			chunk_idx += chunk_sz;
-		      }
-		    while (rem_size > 0);
-
-		    lock_release (&lock_file_sys);
-
-		    return;
-		  }
+		f->eax = -1;
+		return;
 	      }
-	    f->eax = -1;
-
-	    return;
 	  }
+	f->eax = read_to_user (f, fl, user_buffer, size);
 	break;
       }
     case SYS_WRITE:
       {
-	user_sp++;
-	sp = get_kernel_address (f, pd, user_sp, false);
-	int fd = *(int*) sp;
-	page_check_in (cur_proc, pg_round_down (user_sp));
-	user_sp++;
-	sp = get_kernel_address (f, pd, user_sp, false);
-	void *user_buffer = *(void**) sp;
+	int fd = get_user_word (f, ++user_sp);
+	const void *user_buffer = (const void*) get_user_word (f, ++user_sp);
+	unsigned size = get_user_word (f, ++user_sp);
 	if (user_buffer == NULL)
 	  {
-	    page_check_in (cur_proc, pg_round_down (user_sp));
 	    terminate_process (f, -1);
 	    return;
 	  }
-	page_check_in (cur_proc, pg_round_down (user_sp));
-	user_sp++;
-	sp = get_kernel_address (f, pd, user_sp, false);
-	unsigned size = *(unsigned*) sp;
-	page_check_in (cur_proc, pg_round_down (user_sp));
-	if (fd == 0)
+	struct file_desc *fl = NULL;
+	if (fd != 1)
 	  {
-	    f->eax = -1;
-	    return;
-	  }
-	else if (fd == 1)
-	  {
-	    int32_t rem_size = size;
-	    unsigned chunk_idx = 0;
-	    do
-	      {
-		char *kernel_buffer = get_kernel_address (
-		    f, pd, user_buffer + chunk_idx, false);
-		unsigned chunk_sz = MIN(
-		    rem_size,
-		    (char* )next_page (kernel_buffer) - kernel_buffer);
-		putbuf (kernel_buffer, chunk_sz);
-		page_check_in (cur_proc,
-			       pg_round_down (user_buffer + chunk_idx));
-		rem_size -= chunk_sz;
-		chunk_idx += chunk_sz;
-	      }
-	    while (rem_size > 0);
-
-	    f->eax = size;
-
-	    return;
-	  }
-	else
-	  {
-	    struct list_elem *e;
-	    for (e = list_begin (cur_proc->list_file_desc);
-		e != list_end (cur_proc->list_file_desc); e = list_next (e))
+	    fl = fd == 0 ? NULL : lookup_fd (cur_proc, fd);
+	    if (fl == NULL)
 	      {
-		struct file_desc *fl = list_entry(e, struct file_desc, elem);
-		if (fl->fd == fd)
-		  {
-		    lock_acquire (&lock_file_sys);
-
-		    int32_t rem_size = size;
-		    unsigned chunk_idx = 0;
-		    f->eax = 0;
-		    do
-		      {
-			uint8_t *kernel_buffer = get_kernel_address (
-			    f, pd, user_buffer + chunk_idx, false);
-			unsigned chunk_sz = MIN(
-			    rem_size,
-			    (uint8_t* )next_page (kernel_buffer)
-				- kernel_buffer);
-			off_t sz = file_write_at (fl->f, kernel_buffer,
-						  chunk_sz, fl->pos);
-			f->eax += sz;
-			fl->pos += sz;
-			page_check_in (cur_proc,
-				       pg_round_down (user_buffer + chunk_idx));
-			rem_size -= chunk_sz;
-			chunk_idx += chunk_sz;
-		      }
-		    while (rem_size > 0);
-		    lock_release (&lock_file_sys);
-
-		    return;
-		  }
+		f->eax = -1;
+		return;
 	      }
-
-	    f->eax = -1;
-	    return;
 	  }
+	f->eax = write_from_user (f, fl, user_buffer, size);
 	break;
       }
     case SYS_SEEK:
       {
-	user_sp++;
-	sp = get_kernel_address (f, pd, user_sp, false);
-	int fd = *(int*) sp;
-	page_check_in (cur_proc, pg_round_down (user_sp));
-	user_sp++;
-	sp = get_kernel_address (f, pd, user_sp, false);
-	unsigned position = *(unsigned*) sp;
-	if ((fd == 0) || (fd == 1))
-	  {
-	    page_check_in (cur_proc, pg_round_down (user_sp));
-	    return;
-	  }
-	else
+	int fd = get_user_word (f, ++user_sp);
+	unsigned position = get_user_word (f, ++user_sp);
+	struct file_desc *fl =
+	    (fd == 0 || fd == 1) ? NULL : lookup_fd (cur_proc, fd);
+	if (fl != NULL)
 	  {
-	    struct list_elem *e;
-	    for (e = list_begin (cur_proc->list_file_desc);
-		e != list_end (cur_proc->list_file_desc); e = list_next (e))
-	      {
-		struct file_desc *fl = list_entry(e, struct file_desc, elem);
-		if (fl->fd == fd)
-		  {
-		    fl->pos = position;
-		    page_check_in (cur_proc, pg_round_down (user_sp));
-		    return;
-		  }
-	      }
+	    fl->pos = position;
 	  }
 	break;
       }
     case SYS_TELL:
       {
-	user_sp++;
-	sp = get_kernel_address (f, pd, user_sp, false);
-	int fd = *(int*) sp;
-	if ((fd == 0) || (fd == 1))
+	int fd = get_user_word (f, ++user_sp);
+	struct file_desc *fl =
+	    (fd == 0 || fd == 1) ? NULL : lookup_fd (cur_proc, fd);
+	if (fl == NULL)
 	  {
-	    page_check_in (cur_proc, pg_round_down (user_sp));
-	    terminate_process (f, -1);
-	    return;
-	  }
-	else
-	  {
-	    struct list_elem *e;
-	    for (e = list_begin (cur_proc->list_file_desc);
-		e != list_end (cur_proc->list_file_desc); e = list_next (e))
-	      {
-		struct file_desc *fl = list_entry(e, struct file_desc, elem);
-		if (fl->fd == fd)
-		  {
-		    f->eax = fl->pos;
-		    page_check_in (cur_proc, pg_round_down (user_sp));
-		    return;
-		  }
-	      }
-	    page_check_in (cur_proc, pg_round_down (user_sp));
 	    terminate_process (f, -1);
 	    return;
 	  }
+	f->eax = fl->pos;
 	break;
       }
     case SYS_CLOSE:
       {
-	user_sp++;
-	sp = get_kernel_address (f, pd, user_sp, false);
-	int fd = *(int*) sp;
-	if ((fd == 0) || (fd == 1))
-	  {
-	    page_check_in (cur_proc, pg_round_down (user_sp));
-	    terminate_process (f, -1);
-	  }
-	else
+	int fd = get_user_word (f, ++user_sp);
+	struct file_desc *fl =
+	    (fd == 0 || fd == 1) ? NULL : lookup_fd (cur_proc, fd);
+	if (fl == NULL)
 	  {
-	    struct list_elem *e;
-	    for (e = list_begin (cur_proc->list_file_desc);
-		e != list_end (cur_proc->list_file_desc); e = list_next (e))
-	      {
-		struct file_desc *fl = list_entry(e, struct file_desc, elem);
-		if (fl->fd == fd)
-		  {
-		    list_remove (&fl->elem);
-		    free (fl);
-		    page_check_in (cur_proc, pg_round_down (user_sp));
-		    return;
-		  }
-	      }
-	    page_check_in (cur_proc, pg_round_down (user_sp));
 	    terminate_process (f, -1);
 	    return;
 	  }
+	list_remove (&fl->elem);
+	kmem_cache_free (&file_desc_slab, fl);
 	break;
       }
     case SYS_MMAP:
       {
-	user_sp++;
-	sp = get_kernel_address (f, pd, user_sp, false);
-	int fd = *(int*) sp;
+	int fd = get_user_word (f, ++user_sp);
 	if ((fd == 0) || (fd == 1))
 	  {
 	    f->eax = -1;
-	    page_check_in (cur_proc, pg_round_down (user_sp));
 	    return;
 	  }
-	page_check_in (cur_proc, pg_round_down (user_sp));
-	user_sp++;
-	sp = get_kernel_address (f, pd, user_sp, false);
-	void *addr = *(void**) sp;
+	void *addr = (void*) get_user_word (f, ++user_sp);
 	if (addr == NULL)
 	  {
 	    f->eax = -1;
-	    page_check_in (cur_proc, pg_round_down (user_sp));
 	    return;
 	  }
-	struct list_elem *e;
-	for (e = list_begin (cur_proc->list_file_desc);
-	    e != list_end (cur_proc->list_file_desc); e = list_next (e))
+	struct file_desc *fl = lookup_fd (cur_proc, fd);
+	if (fl == NULL)
 	  {
-	    struct file_desc *fl = list_entry(e, struct file_desc, elem);
-	    if (fl->fd == fd)
+	    terminate_process (f, -1);
+	    return;
+	  }
+	lock_acquire (&lock_file_sys);
+	struct file *new_f = file_reopen (fl->f);
+	lock_release (&lock_file_sys);
+	struct mapping *mp = mapping_alloc (cur_proc, addr, new_f);
+	f->eax = mp == NULL ? MAP_FAILED : mp->map_id;
+	break;
+      }
+    case SYS_MUNMAP:
+      {
+	mapid_t mapping = get_user_word (f, ++user_sp);
+	mapping_free (cur_proc, mapping);
+	break;
+      }
+    case SYS_MSYNC:
+      {
+	mapid_t mapping = get_user_word (f, ++user_sp);
+	f->eax = mapping_sync (cur_proc, mapping) ? 0 : -1;
+	break;
+      }
+    case SYS_VMSTAT:
+      {
+	struct vmstat *user_stats = (struct vmstat*) get_user_word (f, ++user_sp);
+	struct vmstat stats;
+	vmstat_get (&stats);
+	if (!copy_to_user (user_stats, &stats, sizeof stats))
+	  {
+	    terminate_process (f, -1);
+	    return;
+	  }
+	f->eax = 0;
+	break;
+      }
+    case SYS_SBRK:
+      {
+	intptr_t increment = get_user_word (f, ++user_sp);
+	f->eax = (uint32_t) region_sbrk (cur_proc, increment);
+	break;
+      }
+    case SYS_MMAP_FLAGS:
+      {
+	int fd = get_user_word (f, ++user_sp);
+	void *addr = (void*) get_user_word (f, ++user_sp);
+	size_t length = get_user_word (f, ++user_sp);
+	int flags = get_user_word (f, ++user_sp);
+	struct mapping *mp = NULL;
+	if (addr != NULL && (flags & MAP_ANONYMOUS))
+	  {
+	    mp = mapping_alloc_anon (cur_proc, addr, length);
+	  }
+	else if (addr != NULL && fd != 0 && fd != 1)
+	  {
+	    struct file_desc *fl = lookup_fd (cur_proc, fd);
+	    if (fl != NULL)
 	      {
 		lock_acquire (&lock_file_sys);
 		struct file *new_f = file_reopen (fl->f);
 		lock_release (&lock_file_sys);
-		struct mapping *mp = mapping_alloc (cur_proc, addr, new_f);
-		if (mp == NULL)
-		  {
-		    f->eax = -1;
-		  }
-		else
-		  {
-		    f->eax = mp->map_id;
-		  }
-		page_check_in (cur_proc, pg_round_down (user_sp));
-		return;
+		mp = mapping_alloc (cur_proc, addr, new_f);
 	      }
 	  }
-	page_check_in (cur_proc, pg_round_down (user_sp));
-	terminate_process (f, -1);
+	if (mp != NULL && (flags & MAP_POPULATE))
+	  {
+	    mapping_populate (mp);
+	  }
+	f->eax = mp == NULL ? MAP_FAILED : mp->map_id;
 	break;
       }
-    case SYS_MUNMAP:
+    case SYS_MADVISE:
       {
-	user_sp++;
-	sp = get_kernel_address (f, pd, user_sp, false);
-	mapid_t mapping = *(mapid_t*) sp;
-	mapping_free (cur_proc, mapping);
-	page_check_in (cur_proc, pg_round_down (user_sp));
+	void *addr = (void*) get_user_word (f, ++user_sp);
+	size_t length = get_user_word (f, ++user_sp);
+	int advice = get_user_word (f, ++user_sp);
+	f->eax = region_advise (cur_proc, addr, length, advice) ? 0 : -1;
+	break;
+      }
+    case SYS_MLOCK:
+      {
+	void *addr = (void*) get_user_word (f, ++user_sp);
+	size_t length = get_user_word (f, ++user_sp);
+	f->eax = page_mlock (cur_proc, addr, length) ? 0 : -1;
+	break;
+      }
+    case SYS_MUNLOCK:
+      {
+	void *addr = (void*) get_user_word (f, ++user_sp);
+	size_t length = get_user_word (f, ++user_sp);
+	page_munlock (cur_proc, addr, length);
+	f->eax = 0;
 	break;
       }
     default:
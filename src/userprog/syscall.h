@@ -1,6 +1,11 @@
 #ifndef USERPROG_SYSCALL_H
 #define USERPROG_SYSCALL_H
 
+#include "threads/slab.h"
+
+/* Cache of struct file_desc. */
+extern struct kmem_cache file_desc_slab;
+
 void
 syscall_init (void);
 
@@ -0,0 +1,104 @@
+#include "userprog/uaccess.h"
+#include <string.h>
+#include "threads/vaddr.h"
+
+/* The running process's page directory stays active while the
+   kernel handles its system calls, so the kernel can access user
+   memory directly instead of translating every address by hand.
+
+   A page fault on such an access is handled like a user fault,
+   bringing the page in or growing the stack, and the access is
+   retried.  If the address is bad, page_fault() looks up the
+   faulting instruction in the exception table and resumes at its
+   fixup address, so the copy below returns early instead of
+   killing the kernel.
+
+   Since a fault may need to load a file page, none of these may
+   be called while holding lock_file_sys or a checked out page. */
+
+/* Exception table entry. */
+struct exception_entry
+  {
+    uintptr_t insn;             /* Instruction that may fault. */
+    uintptr_t fixup;            /* Where to resume if it does. */
+  };
+
+/* Exception table bounds, from the linker script. */
+extern const struct exception_entry __start_ex_table[], __stop_ex_table[];
+
+/* Copies SIZE bytes from SRC to DST, one of which is a user
+   address.  Returns the number of bytes not copied. */
+static size_t
+copy_user (void *dst, const void *src, size_t size)
+{
+  asm volatile ("1: rep movsb\n"
+                "2:\n"
+                ".section __ex_table, \"a\"\n"
+                ".long 1b, 2b\n"
+                ".previous"
+                : "+c" (size), "+D" (dst), "+S" (src)
+                :
+                : "memory");
+  return size;
+}
+
+/* Returns true if the SIZE bytes at UADDR lie in user space. */
+static bool
+is_user_range (const void *uaddr, size_t size)
+{
+  return (uintptr_t) uaddr + size >= (uintptr_t) uaddr
+         && (uintptr_t) uaddr + size <= (uintptr_t) PHYS_BASE;
+}
+
+/* Copies SIZE bytes from user address USRC to DST.
+   Returns false if any of them cannot be read. */
+bool
+copy_from_user (void *dst, const void *usrc, size_t size)
+{
+  return is_user_range (usrc, size) && copy_user (dst, usrc, size) == 0;
+}
+
+/* Copies SIZE bytes from SRC to user address UDST.
+   Returns false if any of them cannot be written. */
+bool
+copy_to_user (void *udst, const void *src, size_t size)
+{
+  return is_user_range (udst, size) && copy_user (udst, src, size) == 0;
+}
+
+/* Copies the null-terminated string at user address USRC into
+   the SIZE bytes at DST.  Returns false if it cannot be read or
+   does not fit. */
+bool
+copy_string_from_user (char *dst, const char *usrc, size_t size)
+{
+  size_t ofs = 0;
+
+  while (ofs < size)
+    {
+      /* Never read past the end of the page that holds the
+         terminator, which may be the last one mapped. */
+      size_t chunk = PGSIZE - pg_ofs (usrc + ofs);
+      if (chunk > size - ofs)
+        chunk = size - ofs;
+      if (!copy_from_user (dst + ofs, usrc + ofs, chunk))
+        return false;
+      if (memchr (dst + ofs, '\0', chunk) != NULL)
+        return true;
+      ofs += chunk;
+    }
+  return false;
+}
+
+/* Returns the fixup address for a fault at EIP, or 0 if EIP is
+   not allowed to fault. */
+uintptr_t
+uaccess_fixup (uintptr_t eip)
+{
+  const struct exception_entry *e;
+
+  for (e = __start_ex_table; e < __stop_ex_table; e++)
+    if (e->insn == eip)
+      return e->fixup;
+  return 0;
+}
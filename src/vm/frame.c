@@ -9,156 +9,835 @@
 #include "threads/vaddr.h"
 #include "threads/palloc.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
 #include "userprog/pagedir.h"
+#include "userprog/process.h"
+#include "devices/timer.h"
+#include "string.h"
 #include "swap.h"
+#include "vmstat.h"
 #include "frame.h"
 #include "stdio.h"
 
-static struct hash frame_table;
+extern struct lock lock_file_sys;
+
+/* All frames in use by user pages, in clock order. */
+static struct list frame_table;
+static size_t frame_cnt;
+static struct list_elem *clock_hand;
+
+/* Frames holding file data, indexed by (inode, offset, writable) so
+ that every process mapping the same file page shares one frame.
+ Read-only executable pages and writable file mappings are kept apart,
+ so that writes through a mapping never show up in a running program.
+ Writable frames track dirtiness for all of their mappers and are
+ written back as a whole, once. */
+static struct hash page_cache;
+
+/* Threads in frame_cache_wait() sleep on CACHE_CHANGED until a cached
+ frame is checked in or leaves the cache, which bumps CACHE_GEN. */
+static struct lock cache_wait_lock;
+static struct condition cache_changed;
+static unsigned cache_gen;
+static int cache_waiters;
+
+/* Protects frame_table, clock_hand and page_cache.  May be acquired
+ while holding a frame_sema, so code holding it must only ever try to
+ down a frame_sema. */
 static struct semaphore frame_table_sema;
-struct hash_iterator i;
 
-/* Returns a hash value for frame f */
+/* Read-only frame of zeros mapped on reads of untouched PAGE_TYPE_ZERO
+ pages.  Not part of the frame table, so it is never evicted. */
+static struct frame zero_frame;
+
+/* Eviction writer.  A victim whose pages must be written out is
+ unmapped and queued here, still checked out, and the faulting thread
+ moves on to look for a clean frame.  The writer thread saves the
+ pages and frees the frame, and the faulter takes it if it found none.
+ At most WRITEBACK_MAX frames are queued or being written at once. */
+#define WRITEBACK_MAX 8
+static struct list writeback_list;
+static size_t writeback_cnt; /* Frames queued or being written */
+static struct lock writeback_lock; /* Protects the two above */
+static struct condition writeback_ready; /* A frame was queued */
+static struct condition writeback_done; /* A frame was written */
+
+/* Longest an allocation waits, in timer ticks, for the process the OOM
+ killer picked to exit and free its memory.  The victim may be blocked,
+ perhaps on the allocating process itself, so after that the allocation
+ fails instead. */
+#define OOM_WAIT_TICKS TIMER_FREQ
+
+/* Cache of struct frame.  Frames are freed checked out and unused,
+ which is the state the constructor leaves them in. */
+static struct kmem_cache frame_slab;
+
+static void
+frame_ctor (void *f_)
+{
+  struct frame *f = f_;
+  sema_init (&f->frame_sema, 0);
+  list_init (&f->user_pages);
+}
+
+/* Returns a hash value for cached frame f */
 static unsigned
-frame_hash (const struct hash_elem *f_, void *aux UNUSED)
+frame_cache_hash (const struct hash_elem *f_, void *aux UNUSED)
+{
+  const struct frame *f = hash_entry(f_, struct frame, cache_elem);
+  uint32_t key[3] =
+    { (uint32_t) f->inode, (uint32_t) f->offset, f->writable };
+  return hash_bytes (key, sizeof key);
+}
+
+/* Returns true if cached frame a precedes cached frame b */
+static bool
+frame_cache_less (const struct hash_elem *a_, const struct hash_elem *b_,
+		  void *aux UNUSED)
+{
+  const struct frame *a = hash_entry(a_, struct frame, cache_elem);
+  const struct frame *b = hash_entry(b_, struct frame, cache_elem);
+  if (a->inode != b->inode)
+    {
+      return a->inode < b->inode;
+    }
+  if (a->offset != b->offset)
+    {
+      return a->offset < b->offset;
+    }
+  return a->writable < b->writable;
+}
+
+/* Wakes the threads waiting in frame_cache_wait(). */
+static void
+frame_cache_wake (void)
+{
+  if (cache_waiters > 0)
+    {
+      lock_acquire (&cache_wait_lock);
+      cache_gen++;
+      cond_broadcast (&cache_changed, &cache_wait_lock);
+      lock_release (&cache_wait_lock);
+    }
+}
+
+/* Drops F from the page cache, if it is there.  F keeps its inode, so
+ that the pages still mapping it are written back to the file.  Must
+ be called with frame_table_sema held. */
+static void
+frame_cache_remove (struct frame *f)
+{
+  if (f->cached)
+    {
+      hash_delete (&page_cache, &f->cache_elem);
+      f->cached = false;
+      frame_cache_wake ();
+    }
+}
+
+/* Removes F from the frame table and the page cache.
+ Must be called with frame_table_sema held. */
+static void
+frame_remove (struct frame *f)
+{
+  if (clock_hand == &f->l_elem)
+    {
+      clock_hand = list_next (clock_hand);
+    }
+  list_remove (&f->l_elem);
+  frame_cnt--;
+  frame_cache_remove (f);
+  f->inode = NULL;
+}
+
+/* Writes shared writable frame F back to its inode if it, or any page
+ mapping it, is dirty, and marks them all clean.  Must be called with
+ F's frame_sema held. */
+static void
+frame_write_back (struct frame *f)
+{
+  ASSERT(f->inode != NULL && f->writable);
+  bool dirty = f->dirty;
+  f->dirty = false;
+  struct list_elem *e;
+  for (e = list_begin (&f->user_pages); e != list_end (&f->user_pages); e =
+      list_next (e))
+    {
+      struct page *pg = list_entry(e, struct page, f_elem);
+      if (pagedir_is_dirty (pg->pagedir, pg->user_address))
+	{
+	  pagedir_set_dirty (pg->pagedir, pg->user_address, false);
+	  dirty = true;
+	}
+    }
+  if (dirty)
+    {
+      lock_acquire (&lock_file_sys);
+      ASSERT(
+	  inode_write_at (f->inode, f->kernel_address, f->size, f->offset)
+	      == f->size);
+      lock_release (&lock_file_sys);
+      VMSTAT_INC(writebacks);
+    }
+}
+
+/* Returns the frame under the clock hand and advances the hand.
+ Must be called with frame_table_sema held on a non-empty table. */
+static struct frame*
+frame_clock_advance (void)
+{
+  if (clock_hand == NULL || clock_hand == list_end (&frame_table))
+    {
+      clock_hand = list_begin (&frame_table);
+    }
+  struct frame *f = list_entry(clock_hand, struct frame, l_elem);
+  clock_hand = list_next (clock_hand);
+  VMSTAT_INC(clock_scans);
+  return f;
+}
+
+/* Returns true if a page mapping FR belongs to a process that has
+ reached its resident set limit, or to IDLEST.  Must be called with
+ FR's frame_sema held. */
+static bool
+frame_is_preferred (struct frame *fr, struct process *idlest,
+		    bool *over_limit)
+{
+  struct list_elem *e;
+  bool preferred = false;
+  for (e = list_begin (&fr->user_pages); e != list_end (&fr->user_pages); e =
+      list_next (e))
+    {
+      struct page *pg = list_entry(e, struct page, f_elem);
+      if (process_over_rss_limit (pg->proc))
+	{
+	  *over_limit = true;
+	  return true;
+	}
+      preferred |= pg->proc == idlest;
+    }
+  return preferred;
+}
+
+/* Returns true if evicting FR would take disk writes.  Must be called
+ with FR's frame_sema held. */
+static bool
+frame_needs_io (struct frame *fr)
+{
+  if (fr->dirty)
+    {
+      return true;
+    }
+  struct list_elem *e;
+  for (e = list_begin (&fr->user_pages); e != list_end (&fr->user_pages); e =
+      list_next (e))
+    {
+      if (page_evict_needs_io (list_entry(e, struct page, f_elem)))
+	{
+	  return true;
+	}
+    }
+  return false;
+}
+
+/* Saves and detaches the pages of FR that page_evict_start() unmapped,
+ then frees FR, or checks it back in if some page stayed. */
+static void
+frame_evict_finish (struct frame *fr)
+{
+  struct list_elem *e = list_begin (&fr->user_pages);
+  while (e != list_end (&fr->user_pages))
+    {
+      struct page *pg = list_entry(e, struct page, f_elem);
+      e = list_next (e);
+      if (pg->evicting)
+	{
+	  page_evict_finish (pg);
+	}
+    }
+  if (!list_empty (&fr->user_pages))
+    {
+      frame_check_in (fr);
+      return;
+    }
+  if (fr->inode != NULL && fr->writable)
+    {
+      frame_write_back (fr);
+    }
+  frame_free (fr);
+}
+
+/* Writes out the frames queued by frame_try_evict(), in order. */
+static void
+frame_writer (void *aux UNUSED)
+{
+  lock_acquire (&writeback_lock);
+  while (true)
+    {
+      while (list_empty (&writeback_list))
+	{
+	  cond_wait (&writeback_ready, &writeback_lock);
+	}
+      struct frame *fr = list_entry(list_pop_front (&writeback_list),
+				    struct frame, writeback_elem);
+      lock_release (&writeback_lock);
+
+      frame_evict_finish (fr);
+
+      lock_acquire (&writeback_lock);
+      writeback_cnt--;
+      cond_broadcast (&writeback_done, &writeback_lock);
+    }
+}
+
+/* Hands FR, checked out, to the writer if it has room, after unmapping
+ every page of FR that is not busy.  Returns false, leaving FR alone,
+ if the writer is full. */
+static bool
+frame_writeback_queue (struct frame *fr)
+{
+  lock_acquire (&writeback_lock);
+  bool queued = writeback_cnt < WRITEBACK_MAX;
+  if (queued)
+    {
+      struct list_elem *e;
+      for (e = list_begin (&fr->user_pages); e != list_end (&fr->user_pages);
+	  e = list_next (e))
+	{
+	  struct page *pg = list_entry(e, struct page, f_elem);
+	  page_evict_start (pg->proc, pg->user_address);
+	}
+      list_push_back (&writeback_list, &fr->writeback_elem);
+      writeback_cnt++;
+      cond_signal (&writeback_ready, &writeback_lock);
+      VMSTAT_INC(evict_async);
+    }
+  lock_release (&writeback_lock);
+  return queued;
+}
+
+/* Waits until the writer has finished a frame, which most likely freed
+ it.  Returns false at once if the writer has nothing to do. */
+static bool
+frame_writeback_wait (void)
+{
+  lock_acquire (&writeback_lock);
+  bool busy = writeback_cnt > 0;
+  if (busy)
+    {
+      cond_wait (&writeback_done, &writeback_lock);
+    }
+  lock_release (&writeback_lock);
+  return busy;
+}
+
+/* Decides whether to evict FR.  With SECOND_CHANCE, gives up if any
+ page mapping FR has been accessed since the clock last came by.
+ Updates the working set estimates along the way.  Returns true if FR
+ should be evicted in place with frame_evict(), which the caller must
+ do after releasing frame_table_sema.  Otherwise FR has been checked
+ in, or handed to the writer if its pages have to be written out.
+ Must be called with frame_table_sema and FR's frame_sema held. */
+static bool
+frame_try_evict (struct frame *fr, bool second_chance)
 {
-  const struct frame *f = hash_entry(f_, struct frame, h_elem);
-  uint32_t key = (uint32_t) (f->kernel_address);
-  return hash_bytes (&key, sizeof key);
+  if (list_empty (&fr->user_pages))
+    {
+      // Frame is still being set up by its owner
+      frame_check_in (fr);
+      return false;
+    }
+  bool accessed = false;
+  struct list_elem *e;
+  for (e = list_begin (&fr->user_pages); e != list_end (&fr->user_pages); e =
+      list_next (e))
+    {
+      struct page *pg = list_entry(e, struct page, f_elem);
+      bool page_accessed = pagedir_is_accessed (pg->pagedir, pg->user_address);
+      if (page_accessed)
+	{
+	  pagedir_set_accessed (pg->pagedir, pg->user_address, false);
+	  accessed = true;
+	}
+      if (page_accessed != pg->referenced)
+	{
+	  pg->referenced = page_accessed;
+	  process_rss_add (pg->proc, 0, page_accessed ? 1 : -1);
+	}
+    }
+  if (accessed && second_chance)
+    {
+      frame_check_in (fr);
+      return false;
+    }
+  /* Once swap is full, a write may fail and leave the frame mapped, so
+   evict in place and let the caller see whether anything came free. */
+  if (frame_needs_io (fr) && !swap_full ())
+    {
+      if (!frame_writeback_queue (fr))
+	{
+	  frame_check_in (fr);
+	}
+      return false;
+    }
+  return true;
 }
 
-/* Returns true if frame a precedes frame b */
+/* Evicts every page mapping FR, as picked by frame_try_evict(), and
+ returns true if FR is now unused.  Otherwise FR has been checked in.
+ Pages may have to be written to their file, or fail to go to a full
+ swap, so this must be called without frame_table_sema.  Other threads
+ can allocate and evict in the meantime. */
 static bool
-frame_less (const struct hash_elem *a_, const struct hash_elem *b_,
-	    void *aux UNUSED)
+frame_evict (struct frame *fr)
 {
-  const struct frame *a = hash_entry(a_, struct frame, h_elem);
-  const struct frame *b = hash_entry(b_, struct frame, h_elem);
-  return a->kernel_address < b->kernel_address;
+  struct list_elem *e = list_begin (&fr->user_pages);
+  while (e != list_end (&fr->user_pages))
+    {
+      struct page *pg = list_entry(e, struct page, f_elem);
+      e = list_next (e);
+      page_evict (pg->proc, pg->user_address);
+    }
+  if (!list_empty (&fr->user_pages))
+    {
+      frame_check_in (fr);
+      return false;
+    }
+  if (fr->inode != NULL)
+    {
+      if (fr->writable)
+	{
+	  // The mappers left their dirtiness behind in FR
+	  frame_write_back (fr);
+	}
+      sema_down (&frame_table_sema);
+      frame_cache_remove (fr);
+      fr->inode = NULL;
+      sema_up (&frame_table_sema);
+    }
+  return true;
 }
 
 void
 frame_table_init (void)
 {
   sema_init (&frame_table_sema, 1);
-  hash_init (&frame_table, frame_hash, frame_less, NULL);
+  list_init (&frame_table);
+  frame_cnt = 0;
+  clock_hand = NULL;
+  hash_init (&page_cache, frame_cache_hash, frame_cache_less, NULL);
+  lock_init (&cache_wait_lock);
+  cond_init (&cache_changed);
+  cache_gen = 0;
+  cache_waiters = 0;
+  list_init (&writeback_list);
+  writeback_cnt = 0;
+  lock_init (&writeback_lock);
+  cond_init (&writeback_ready);
+  cond_init (&writeback_done);
+  kmem_cache_init (&frame_slab, "frame", sizeof(struct frame), frame_ctor);
+  zero_frame.kernel_address = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+  list_init (&zero_frame.user_pages);
+  sema_init (&zero_frame.frame_sema, 1);
+  zero_frame.inode = NULL;
+  zero_frame.cached = false;
+  zero_frame.writable = false;
+  zero_frame.dirty = false;
+  zero_frame.pin_cnt = 0;
 }
 
+/* Starts the eviction writer.  Must be called once threads are
+ running. */
+void
+frame_writeback_init (void)
+{
+  thread_create ("evict-writer", PRI_DEFAULT, frame_writer, NULL);
+}
+
+struct frame*
+frame_zero (void)
+{
+  return &zero_frame;
+}
+
+bool
+frame_is_zero (const struct frame *f)
+{
+  return f == &zero_frame;
+}
+
+/* Runs the clock for up to TURNS turns looking for a victim, and
+ returns it checked out for frame_evict(), or NULL.  The first turn only
+ considers frames of processes at their resident set limit, which get
+ no second chance, and of the process with the most idle pages.  With
+ LIMITED_ONLY, that is the only turn.  Must be called with
+ frame_table_sema held. */
+static struct frame*
+frame_clock_scan (size_t turns, bool limited_only)
+{
+  struct process *idlest = limited_only ? NULL : process_idlest ();
+  for (size_t scanned = 0; scanned < turns * frame_cnt; scanned++)
+    {
+      struct frame *fr = frame_clock_advance ();
+      if (fr->pin_cnt > 0 || !sema_try_down (&fr->frame_sema))
+	{
+	  continue;
+	}
+      bool over_limit = false;
+      bool preferred = frame_is_preferred (fr, idlest, &over_limit);
+      if ((scanned >= frame_cnt || preferred)
+	  && (!limited_only || over_limit) && fr->pin_cnt == 0)
+	{
+	  if (frame_try_evict (fr, !over_limit))
+	    {
+	      return fr;
+	    }
+	}
+      else
+	{
+	  frame_check_in (fr);
+	}
+    }
+  return NULL;
+}
+
+/* Runs the clock until a victim has been evicted in place, and returns
+ it checked out and unused, or NULL.  With RECLAIM, only frames of
+ processes at their resident set limit are considered.  A victim can
+ stay mapped if one of its pages is busy or swap is full, in which case
+ the clock moves on, but only for one frame table's worth of victims. */
+static struct frame*
+frame_find_victim (bool reclaim)
+{
+  for (size_t tries = 0;; tries++)
+    {
+      sema_down (&frame_table_sema);
+      struct frame *fr = frame_clock_scan (reclaim ? 1 : 3, reclaim);
+      size_t cnt = frame_cnt;
+      sema_up (&frame_table_sema);
+      if (fr == NULL || frame_evict (fr))
+	{
+	  return fr;
+	}
+      if (tries >= cnt)
+	{
+	  return NULL;
+	}
+    }
+}
+
+/* Returns a checked out frame for a user page, evicting another page
+ if memory is full.  Returns NULL if swap is full too and the OOM
+ policy picked the current process to fail, or the process it picked
+ did not exit within OOM_WAIT_TICKS. */
 struct frame*
 frame_alloc_and_check_out (bool zeroed)
 {
   enum palloc_flags flags = PAL_USER | (zeroed ? PAL_ZERO : 0);
-  struct frame *f = (struct frame*) malloc (sizeof(struct frame));
-  ASSERT(f != NULL);
-  sema_init (&f->frame_sema, 1);
-  f->user_page = NULL;
-  f->kernel_address = palloc_get_page (flags);
-  if (f->kernel_address == NULL)
+  // A process at its limit replaces its own pages while it can
+  struct process *proc = thread_current ()->p;
+  bool reclaim = proc != NULL && process_over_rss_limit (proc);
+  int64_t oom_wait_start = -1;
+  while (true)
     {
-      free (f);
-      sema_down (&frame_table_sema);
-      if (i.elem == NULL)
+      void *kaddr = reclaim ? NULL : palloc_get_page (flags);
+      if (kaddr != NULL)
+	{
+	  struct frame *f = (struct frame*) kmem_cache_alloc (&frame_slab);
+	  ASSERT(f != NULL);
+	  f->kernel_address = kaddr;
+	  f->inode = NULL;
+	  f->cached = false;
+	  f->writable = false;
+	  f->dirty = false;
+	  f->pin_cnt = 0;
+	  sema_down (&frame_table_sema);
+	  if (clock_hand != NULL && clock_hand != list_end (&frame_table))
+	    {
+	      list_insert (clock_hand, &f->l_elem);
+	    }
+	  else
+	    {
+	      list_push_back (&frame_table, &f->l_elem);
+	    }
+	  frame_cnt++;
+	  sema_up (&frame_table_sema);
+	  return f;
+	}
+
+      // Out of frames, run the clock looking for a victim
+      struct frame *fr = frame_find_victim (reclaim);
+      if (fr != NULL)
+	{
+	  if (zeroed)
+	    {
+	      memset (fr->kernel_address, 0, PGSIZE);
+	    }
+	  return fr;
+	}
+      if (reclaim)
+	{
+	  // Nothing of ours to give up, the limit is best effort
+	  reclaim = false;
+	  continue;
+	}
+      // Only dirty frames were found, take the first one written out
+      if (frame_writeback_wait ())
 	{
-	  hash_first (&i, &frame_table);
+	  continue;
 	}
-      while (true)
+      /* Nothing could be evicted.  If that is because swap is full
+       rather than because every frame is busy, someone has to go. */
+      if (swap_full ())
 	{
-	  if (hash_next (&i) == NULL)
+	  if (proc == NULL || process_oom_kill (proc))
 	    {
-	      hash_first (&i, &frame_table);
-	      hash_next (&i);
+	      return NULL;
 	    }
-	  struct frame *fr = hash_entry(hash_cur (&i), struct frame, h_elem);
-	  sema_down (&fr->frame_sema);
-	  ASSERT(fr->user_page != NULL);
-	  void *uaddr = fr->user_page->user_address;
-	  uint32_t *user_pd = fr->user_page->pagedir;
-	  if (pagedir_is_accessed (user_pd, uaddr))
+	  // Give the victim a while to exit, but not forever
+	  if (oom_wait_start < 0)
 	    {
-	      pagedir_set_accessed (user_pd, uaddr, false);
-	      sema_up (&fr->frame_sema);
+	      oom_wait_start = timer_ticks ();
 	    }
-	  else
+	  else if (timer_elapsed (oom_wait_start) > OOM_WAIT_TICKS)
 	    {
-	      if (page_evict (fr->user_page->proc, uaddr))
-		{
-		  sema_up (&frame_table_sema);
-		  fr->user_page = NULL;
-		  return fr;
-		}
-	      else
-		{
-		  sema_up (&fr->frame_sema);
-		}
+	      return NULL;
 	    }
+	  timer_sleep (1);
+	  continue;
+	}
+      // Let the owners of the frames make progress
+      thread_yield ();
+    }
+}
+
+void
+frame_check_in (struct frame *f)
+{
+  ASSERT(f != NULL);
+  bool cached = f->cached;
+  sema_up (&f->frame_sema);
+  if (cached)
+    {
+      frame_cache_wake ();
+    }
+}
+
+void
+frame_free (struct frame *f)
+{
+  ASSERT(f != NULL);
+  ASSERT(list_empty (&f->user_pages));
+  sema_down (&frame_table_sema);
+  frame_remove (f);
+  sema_up (&frame_table_sema);
+  palloc_free_page (f->kernel_address);
+  kmem_cache_free (&frame_slab, f);
+}
+
+/* Records that PG maps F.  Both must be checked out.  Pins PG
+ already holds carry over to F. */
+void
+frame_attach (struct frame *f, struct page *pg)
+{
+  ASSERT(f != NULL);
+  ASSERT(pg != NULL);
+  list_push_back (&f->user_pages, &pg->f_elem);
+  pg->f = f;
+  f->pin_cnt += pg->pin_cnt;
+  pg->referenced = true;
+  process_rss_add (pg->proc, 1, 1);
+}
+
+/* Records that PG no longer maps F, which must be checked out. */
+void
+frame_detach (struct frame *f, struct page *pg)
+{
+  ASSERT(f != NULL);
+  ASSERT(pg != NULL && pg->f == f);
+  list_remove (&pg->f_elem);
+  pg->f = NULL;
+  f->pin_cnt -= pg->pin_cnt;
+  process_rss_add (pg->proc, -1, pg->referenced ? -1 : 0);
+  pg->referenced = false;
+}
+
+/* Adds DELTA to the pin count of F, which the evictor skips while it
+ is non-zero.  The zero frame is never evicted, so it is not counted. */
+void
+frame_pin (struct frame *f, int delta)
+{
+  ASSERT(f != NULL);
+  if (frame_is_zero (f))
+    {
+      return;
+    }
+  sema_down (&f->frame_sema);
+  ASSERT(delta >= 0 || f->pin_cnt >= (unsigned) -delta);
+  f->pin_cnt += delta;
+  frame_check_in (f);
+}
+
+/* Drops PG's mapping of F, freeing F once no page maps it anymore.
+ PG must be checked out and already unmapped from its page directory.
+ A shared writable frame keeps PG's dirtiness and is written back when
+ its last mapper goes. */
+void
+frame_release (struct frame *f, struct page *pg)
+{
+  ASSERT(f != NULL);
+  ASSERT(pg != NULL && pg->f == f);
+  if (frame_is_zero (f))
+    {
+      pg->f = NULL;
+      return;
+    }
+  sema_down (&f->frame_sema);
+  if (f->inode != NULL && f->writable
+      && pagedir_is_dirty (pg->pagedir, pg->user_address))
+    {
+      f->dirty = true;
+    }
+  frame_detach (f, pg);
+  if (list_empty (&f->user_pages))
+    {
+      if (f->inode != NULL && f->writable)
+	{
+	  frame_write_back (f);
 	}
+      frame_free (f);
     }
   else
     {
-      sema_down (&frame_table_sema);
-      ASSERT(hash_insert (&frame_table, &f->h_elem) == NULL);
-      sema_down (&f->frame_sema);
-      sema_up (&frame_table_sema);
-      return f;
+      frame_check_in (f);
     }
 }
 
+/* Returns the checked out frame caching SIZE bytes of INODE at
+ OFFSET, or NULL if there is none.  A busy read-only frame is skipped,
+ since the file holds the same data.  A busy writable one may hold
+ writes the file has not seen yet, so *BUSY is set instead.  The
+ caller must then check its page back in and wait with
+ frame_cache_wait() before trying again.  An entry holding a different
+ SIZE predates a change in the file's length.  It is written back and
+ dropped from the cache, so that the caller's fresh read replaces it. */
 struct frame*
-frame_check_out (void *kaddr)
+frame_cache_check_out (struct inode *inode, off_t offset, off_t size,
+		       bool writable, bool *busy)
 {
-  ASSERT(is_kernel_vaddr (kaddr));
-  struct frame f;
-  f.kernel_address = kaddr;
-  struct hash_elem *e;
+  ASSERT(inode != NULL);
+  struct frame key;
+  key.inode = inode;
+  key.offset = offset;
+  key.writable = writable;
+  *busy = false;
   sema_down (&frame_table_sema);
-  e = hash_find (&frame_table, &f.h_elem);
-  if (e != NULL)
+  struct hash_elem *e = hash_find (&page_cache, &key.cache_elem);
+  if (e == NULL)
+    {
+      sema_up (&frame_table_sema);
+      return NULL;
+    }
+  struct frame *f = hash_entry(e, struct frame, cache_elem);
+  if (!sema_try_down (&f->frame_sema))
     {
-      struct frame *fr = hash_entry(e, struct frame, h_elem);
-      sema_down (&fr->frame_sema);
       sema_up (&frame_table_sema);
-      return fr;
+      *busy = writable;
+      return NULL;
     }
+  if (f->size == size)
+    {
+      sema_up (&frame_table_sema);
+      return f;
+    }
+  frame_cache_remove (f);
   sema_up (&frame_table_sema);
+  if (f->writable)
+    {
+      frame_write_back (f);
+    }
+  frame_check_in (f);
   return NULL;
 }
 
-void
-frame_check_in (void *kaddr)
+/* Returns true if the frame caching INODE at OFFSET, as described by
+ KEY, is checked out. */
+static bool
+frame_cache_busy (struct frame *key)
 {
-  ASSERT(is_kernel_vaddr (kaddr));
-  struct frame f;
-  f.kernel_address = kaddr;
-  struct hash_elem *e;
+  bool busy = false;
   sema_down (&frame_table_sema);
-  e = hash_find (&frame_table, &f.h_elem);
+  struct hash_elem *e = hash_find (&page_cache, &key->cache_elem);
   if (e != NULL)
     {
-      struct frame *fr = hash_entry(e, struct frame, h_elem);
-      sema_up (&fr->frame_sema);
+      struct frame *f = hash_entry(e, struct frame, cache_elem);
+      busy = !sema_try_down (&f->frame_sema);
+      if (!busy)
+	{
+	  sema_up (&f->frame_sema);
+	}
     }
   sema_up (&frame_table_sema);
+  return busy;
 }
 
+/* Sleeps until the frame caching INODE at OFFSET, which
+ frame_cache_check_out() found busy, is checked in or leaves the
+ cache.  Must not be called with a page checked out. */
 void
-frame_free (void *kaddr, bool free_page)
+frame_cache_wait (struct inode *inode, off_t offset, bool writable)
+{
+  ASSERT(inode != NULL);
+  struct frame key;
+  key.inode = inode;
+  key.offset = offset;
+  key.writable = writable;
+  lock_acquire (&cache_wait_lock);
+  cache_waiters++;
+  unsigned gen = cache_gen;
+  lock_release (&cache_wait_lock);
+  bool busy = frame_cache_busy (&key);
+  lock_acquire (&cache_wait_lock);
+  while (busy && gen == cache_gen)
+    {
+      cond_wait (&cache_changed, &cache_wait_lock);
+    }
+  cache_waiters--;
+  lock_release (&cache_wait_lock);
+}
+
+/* Publishes checked out frame F, holding SIZE bytes of INODE at
+ OFFSET, in the page cache.  Returns false if another process raced us
+ to it, in which case F is left private. */
+bool
+frame_cache_insert (struct frame *f, struct inode *inode, off_t offset,
+		    off_t size, bool writable)
 {
-  ASSERT(is_kernel_vaddr (kaddr));
-  struct frame f;
-  f.kernel_address = kaddr;
-  struct hash_elem *e;
+  ASSERT(f != NULL);
+  ASSERT(inode != NULL);
+  f->inode = inode;
+  f->offset = offset;
+  f->size = size;
+  f->writable = writable;
+  f->cached = true;
   sema_down (&frame_table_sema);
-  e = hash_find (&frame_table, &f.h_elem);
-  if (e != NULL)
+  if (hash_insert (&page_cache, &f->cache_elem) != NULL)
     {
-      struct frame *fr = hash_entry(e, struct frame, h_elem);
-      sema_down (&fr->frame_sema);
-      hash_delete (&frame_table, &fr->h_elem);
-      if (free_page)
-	{
-	  palloc_free_page (fr->kernel_address);
-	}
-      free (fr);
+      f->inode = NULL;
+      f->cached = false;
     }
   sema_up (&frame_table_sema);
+  return f->cached;
+}
+
+/* Writes shared writable frame F back to its file if any of its
+ mappers dirtied it.  The caller must have a page mapping F checked
+ out, so that F stays in the page cache. */
+void
+frame_sync (struct frame *f)
+{
+  ASSERT(f != NULL);
+  sema_down (&f->frame_sema);
+  frame_write_back (f);
+  frame_check_in (f);
 }
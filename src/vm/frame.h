@@ -9,29 +9,72 @@
 #define SRC_VM_FRAME_H_
 
 #include "hash.h"
+#include "list.h"
+#include "filesys/inode.h"
 #include "page.h"
 
 struct frame
 {
-  struct hash_elem h_elem; /* Hash table element */
+  struct list_elem l_elem; /* Element in the frame table (clock order) */
   void *kernel_address; /* Kernel virtual address of this frame */
-  struct page *user_page;
+  struct list user_pages; /* Pages mapping this frame (reverse map) */
   struct semaphore frame_sema;
+  struct hash_elem cache_elem; /* Page cache element, if shared */
+  struct inode *inode; /* Backing inode of shared file data, else NULL */
+  bool cached; /* Listed in the page cache under INODE and OFFSET */
+  off_t offset; /* Offset of the cached data in INODE */
+  off_t size; /* Number of bytes read from INODE */
+  bool writable; /* Shared writable file data, written back to INODE */
+  bool dirty; /* Written through a page that no longer maps it */
+  unsigned pin_cnt; /* Pins held by the pages mapping this frame */
+  struct list_elem writeback_elem; /* Element in the eviction writer's queue */
 };
 
 void
 frame_table_init (void);
 
+void
+frame_writeback_init (void);
+
 struct frame*
 frame_alloc_and_check_out (bool zeroed);
 
 void
-frame_free (void *kaddr, bool free_page);
+frame_free (struct frame *f);
+
+void
+frame_check_in (struct frame *f);
+
+struct frame*
+frame_zero (void);
+
+bool
+frame_is_zero (const struct frame *f);
+
+void
+frame_attach (struct frame *f, struct page *pg);
+
+void
+frame_detach (struct frame *f, struct page *pg);
+
+void
+frame_pin (struct frame *f, int delta);
+
+void
+frame_release (struct frame *f, struct page *pg);
 
 struct frame*
-frame_check_out (void *kaddr);
+frame_cache_check_out (struct inode *inode, off_t offset, off_t size,
+		       bool writable, bool *busy);
+
+void
+frame_cache_wait (struct inode *inode, off_t offset, bool writable);
+
+bool
+frame_cache_insert (struct frame *f, struct inode *inode, off_t offset,
+		    off_t size, bool writable);
 
 void
-frame_check_in (void *kaddr);
+frame_sync (struct frame *f);
 
 #endif /* SRC_VM_FRAME_H_ */
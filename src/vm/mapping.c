@@ -8,24 +8,175 @@
 #include "mapping.h"
 #include "threads/vaddr.h"
 #include "page.h"
+#include "region.h"
+#include "round.h"
 #include "frame.h"
 #include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/slab.h"
 #include "threads/thread.h"
 #include "userprog/process.h"
+#include "userprog/pagedir.h"
+#include "devices/timer.h"
+#include "string.h"
+#include "vmstat.h"
 
 extern struct lock lock_file_sys;
 
+/* Most dirty pages written back under one acquisition of
+ lock_file_sys. */
+#define WRITEBACK_BATCH 16
+
+/* Most pages read in under one acquisition of lock_file_sys when
+ populating a mapping. */
+#define POPULATE_BATCH 16
+
+/* How often the flusher writes back dirty mapped pages. */
+#define FLUSH_INTERVAL TIMER_FREQ
+
+/* All file mappings, for the flusher.  FLUSHING is the mapping it is
+ writing back, which must not be released until it is done. */
+static struct list mapping_list;
+static struct lock mapping_list_lock;
+static struct condition flush_done;
+static struct mapping *flushing;
+
+static struct kmem_cache mapping_slab;
+
+/* Writes the dirty resident pages of M back to its file in file order,
+ holding lock_file_sys once per run of consecutive dirty pages.  Dirty
+ bits are cleared before the data is written, so writes made in the
+ meantime are caught by the next writeback.  Pages whose frame is shared
+ with other mappings of the file are written back by the frame, which
+ sees the dirty bits of every mapper. */
 static void
-mapping_deallocate (struct hash_elem *e, void *aux UNUSED)
+mapping_writeback (struct mapping *m)
 {
-  struct mapping *m = hash_entry(e, struct mapping, h_elem);
-  ASSERT(m != NULL);
+  if (m->file == NULL)
+    {
+      return;
+    }
+  struct page *batch[WRITEBACK_BATCH];
+  int i = 0;
+  while (i < m->num_pages)
+    {
+      size_t n = 0;
+      while (i < m->num_pages && n < WRITEBACK_BATCH)
+	{
+	  void *upage = m->upage + (i++ * PGSIZE);
+	  struct page *pg = page_check_out (m->proc, upage, false);
+	  if (pg != NULL && pg->f != NULL && pg->type == PAGE_TYPE_FILE
+	      && !pg->ps.fs.read_only)
+	    {
+	      if (pg->f->inode != NULL)
+		{
+		  frame_sync (pg->f);
+		}
+	      else if (pagedir_is_dirty (pg->pagedir, upage))
+		{
+		  pagedir_set_dirty (pg->pagedir, upage, false);
+		  batch[n++] = pg;
+		  continue;
+		}
+	    }
+	  if (pg != NULL)
+	    {
+	      page_check_in (m->proc, upage);
+	    }
+	  if (n > 0)
+	    {
+	      break;
+	    }
+	}
+      if (n == 0)
+	{
+	  continue;
+	}
+      lock_acquire (&lock_file_sys);
+      for (size_t j = 0; j < n; j++)
+	{
+	  struct page *pg = batch[j];
+	  ASSERT(
+	      file_write_at (pg->ps.fs.f, pg->f->kernel_address, pg->ps.fs.size,
+			     pg->ps.fs.offset) == pg->ps.fs.size);
+	  VMSTAT_INC(writebacks);
+	}
+      lock_release (&lock_file_sys);
+      for (size_t j = 0; j < n; j++)
+	{
+	  page_check_in (m->proc, batch[j]->user_address);
+	}
+    }
+}
+
+/* Periodically writes back the dirty pages of every file mapping, so
+ that eviction, munmap and exit find them mostly clean. */
+static void
+mapping_flusher (void *aux UNUSED)
+{
+  while (true)
+    {
+      timer_sleep (FLUSH_INTERVAL);
+      lock_acquire (&mapping_list_lock);
+      struct list_elem *e = list_begin (&mapping_list);
+      while (e != list_end (&mapping_list))
+	{
+	  flushing = list_entry(e, struct mapping, l_elem);
+	  lock_release (&mapping_list_lock);
+	  mapping_writeback (flushing);
+	  lock_acquire (&mapping_list_lock);
+	  e = list_next (e);
+	  flushing = NULL;
+	  cond_broadcast (&flush_done, &mapping_list_lock);
+	}
+      lock_release (&mapping_list_lock);
+    }
+}
+
+void
+mapping_init (void)
+{
+  list_init (&mapping_list);
+  lock_init (&mapping_list_lock);
+  cond_init (&flush_done);
+  flushing = NULL;
+  kmem_cache_init (&mapping_slab, "mapping", sizeof(struct mapping), NULL);
+  thread_create ("flusher", PRI_DEFAULT, mapping_flusher, NULL);
+}
+
+/* Writes back and frees the pages of mapping M, then M itself.  The
+ region goes first, so that the prefetch worker or another thread
+ faulting on the range cannot create pages behind our back that would
+ outlive M's file. */
+static void
+mapping_release (struct mapping *m)
+{
+  lock_acquire (&mapping_list_lock);
+  while (flushing == m)
+    {
+      cond_wait (&flush_done, &mapping_list_lock);
+    }
+  list_remove (&m->l_elem);
+  lock_release (&mapping_list_lock);
+  region_remove (m->proc, m->upage);
+  mapping_writeback (m);
+  pagedir_clear_pages (thread_current ()->pagedir, m->upage, m->num_pages);
   for (int i = 0; i < m->num_pages; i++)
     {
-      page_evict (m->proc, m->upage + (i * PGSIZE));
       page_free (m->proc, m->upage + (i * PGSIZE));
     }
-  free (m);
+  lock_acquire (&lock_file_sys);
+  file_close (m->file);
+  lock_release (&lock_file_sys);
+  kmem_cache_free (&mapping_slab, m);
+}
+
+static void
+mapping_deallocate (struct hash_elem *e, void *aux UNUSED)
+{
+  struct mapping *m = hash_entry(e, struct mapping, h_elem);
+  ASSERT(m != NULL);
+  mapping_release (m);
 }
 
 static unsigned
@@ -65,6 +216,28 @@ mapping_table_destroy (struct process *proc)
   free (proc->mapping_table);
 }
 
+/* Records a mapping of NUM_PAGES pages at UPAGE backed by F, whose
+ region must already have been added. */
+static struct mapping*
+mapping_insert (struct process *proc, void *upage, int num_pages,
+		struct file *f)
+{
+  struct mapping *mp = (struct mapping*) kmem_cache_alloc (&mapping_slab);
+  ASSERT(mp != NULL);
+  mp->upage = upage;
+  mp->num_pages = num_pages;
+  mp->file = f;
+  mp->proc = proc;
+  lock_acquire (&proc->mapping_table_lock);
+  mp->map_id = proc->mapping_counter++;
+  ASSERT(hash_insert(proc->mapping_table, &mp->h_elem) == NULL);
+  lock_release (&proc->mapping_table_lock);
+  lock_acquire (&mapping_list_lock);
+  list_push_back (&mapping_list, &mp->l_elem);
+  lock_release (&mapping_list_lock);
+  return mp;
+}
+
 struct mapping*
 mapping_alloc (struct process *proc, void *upage, struct file *f)
 {
@@ -75,30 +248,35 @@ mapping_alloc (struct process *proc, void *upage, struct file *f)
   ASSERT(upage != NULL);
   ASSERT(proc != NULL);
   ASSERT(is_user_vaddr (upage));
-  struct mapping *mp = (struct mapping*) malloc (sizeof(struct mapping));
-  ASSERT(mp != NULL);
   lock_acquire (&lock_file_sys);
   off_t file_size = file_length (f);
   lock_release (&lock_file_sys);
-  if (file_size == 0)
+  if (file_size == 0
+      || !region_add (proc, REGION_MMAP, upage, thread_current ()->pagedir, f,
+		      0, file_size, ROUND_UP (file_size, PGSIZE) - file_size,
+		      true, false))
     {
-      free (mp);
+      lock_acquire (&lock_file_sys);
+      file_close (f);
+      lock_release (&lock_file_sys);
       return NULL;
     }
-  if (!load_segment (f, 0, upage, file_size, PGSIZE - (file_size % PGSIZE),
-		     true, false))
+  return mapping_insert (proc, upage, DIV_ROUND_UP (file_size, PGSIZE), f);
+}
+
+/* Maps LENGTH bytes of zero-filled memory at UPAGE, rounded up to
+ whole pages.  Its pages go to swap when evicted, like the heap. */
+struct mapping*
+mapping_alloc_anon (struct process *proc, void *upage, size_t length)
+{
+  ASSERT(proc != NULL);
+  if (length == 0 || length > (size_t) PHYS_BASE
+      || !region_add (proc, REGION_MMAP, upage, thread_current ()->pagedir,
+		      NULL, 0, 0, ROUND_UP (length, PGSIZE), true, false))
     {
-      free (mp);
       return NULL;
     }
-  mp->map_id = proc->mapping_counter++;
-  mp->upage = upage;
-  mp->num_pages = file_size / PGSIZE + ((file_size % PGSIZE == 0) ? 0 : 1);
-  mp->proc = proc;
-  lock_acquire (&proc->mapping_table_lock);
-  ASSERT(hash_insert(proc->mapping_table, &mp->h_elem) == NULL);
-  lock_release (&proc->mapping_table_lock);
-  return mp;
+  return mapping_insert (proc, upage, DIV_ROUND_UP (length, PGSIZE), NULL);
 }
 
 void
@@ -112,12 +290,152 @@ mapping_free (struct process *proc, mapid_t map_id)
   if (e != NULL)
     {
       struct mapping *mp = hash_entry(e, struct mapping, h_elem);
-      for (int i = 0; i < mp->num_pages; i++)
+      mapping_release (mp);
+    }
+  lock_release (&proc->mapping_table_lock);
+}
+
+/* Writes back the dirty pages of mapping MAP_ID.  Returns false if
+ PROC has no such mapping. */
+bool
+mapping_sync (struct process *proc, mapid_t map_id)
+{
+  struct mapping m;
+  struct hash_elem *e;
+  m.map_id = map_id;
+  lock_acquire (&proc->mapping_table_lock);
+  e = hash_find (proc->mapping_table, &m.h_elem);
+  if (e != NULL)
+    {
+      mapping_writeback (hash_entry(e, struct mapping, h_elem));
+    }
+  lock_release (&proc->mapping_table_lock);
+  return e != NULL;
+}
+
+/* Reads the untouched pages of file mapping M in file order and maps
+ them.  Each run of up to POPULATE_BATCH consecutive untouched pages is
+ read with a single file_read_at() into a kernel buffer, then copied
+ into the pages' frames.  Pages another process already has in the
+ page cache are mapped without I/O and end the run.  Pages of anonymous
+ mappings are given zeroed frames. */
+void
+mapping_populate (struct mapping *m)
+{
+  ASSERT(m != NULL);
+  struct page *batch[POPULATE_BATCH];
+  struct frame *frames[POPULATE_BATCH];
+  int i = 0;
+  while (i < m->num_pages)
+    {
+      size_t n = 0;
+      while (i < m->num_pages && n < POPULATE_BATCH)
+	{
+	  void *upage = m->upage + (i++ * PGSIZE);
+	  if (m->file == NULL)
+	    {
+	      load_page (m->proc, upage, true, false);
+	      continue;
+	    }
+	  struct page *pg = region_page_check_out (m->proc, upage);
+	  if (pg == NULL)
+	    {
+	      break;
+	    }
+	  if (pg->f != NULL || pg->type != PAGE_TYPE_FILE)
+	    {
+	      page_check_in (m->proc, upage);
+	      break;
+	    }
+	  struct inode *inode = file_get_inode (pg->ps.fs.f);
+	  bool busy;
+	  struct frame *fr = frame_cache_check_out (inode, pg->ps.fs.offset,
+						    pg->ps.fs.size, true,
+						    &busy);
+	  if (busy)
+	    {
+	      // Someone is using it, leave it to be faulted in
+	      page_check_in (m->proc, upage);
+	      break;
+	    }
+	  if (fr != NULL)
+	    {
+	      VMSTAT_INC(cache_hits);
+	      if (!install_page (fr, pg, pg->writable)
+		  && list_empty (&fr->user_pages))
+		{
+		  frame_free (fr);
+		}
+	      else
+		{
+		  frame_check_in (fr);
+		}
+	      page_check_in (m->proc, upage);
+	      break;
+	    }
+	  fr = frame_alloc_and_check_out (false);
+	  if (fr == NULL)
+	    {
+	      // Out of memory, leave the rest to be faulted in
+	      page_check_in (m->proc, upage);
+	      i = m->num_pages;
+	      break;
+	    }
+	  batch[n] = pg;
+	  frames[n++] = fr;
+	}
+      if (n == 0)
+	{
+	  continue;
+	}
+      /* The batch covers consecutive pages of the file, of which only
+       the last may be short. */
+      struct file *file = batch[0]->ps.fs.f;
+      off_t size = (n - 1) * PGSIZE + batch[n - 1]->ps.fs.size;
+      uint8_t *buf = palloc_get_multiple (0, n);
+      lock_acquire (&lock_file_sys);
+      if (buf != NULL)
+	{
+	  ASSERT(file_read_at (file, buf, size, batch[0]->ps.fs.offset) == size);
+	}
+      else
+	{
+	  // No room for the buffer, read straight into the frames
+	  for (size_t j = 0; j < n; j++)
+	    {
+	      struct page *pg = batch[j];
+	      ASSERT(
+		  file_read_at (file, frames[j]->kernel_address, pg->ps.fs.size,
+				pg->ps.fs.offset) == pg->ps.fs.size);
+	    }
+	}
+      lock_release (&lock_file_sys);
+      for (size_t j = 0; j < n; j++)
 	{
-	  page_evict (mp->proc, mp->upage + (i * PGSIZE));
-	  page_free (mp->proc, mp->upage + (i * PGSIZE));
+	  struct page *pg = batch[j];
+	  struct frame *fr = frames[j];
+	  if (buf != NULL)
+	    {
+	      memcpy (fr->kernel_address, buf + j * PGSIZE, pg->ps.fs.size);
+	    }
+	  VMSTAT_INC(file_fills);
+	  memset (fr->kernel_address + pg->ps.fs.size, 0,
+		  PGSIZE - pg->ps.fs.size);
+	  if (frame_cache_insert (fr, file_get_inode (pg->ps.fs.f),
+				  pg->ps.fs.offset, pg->ps.fs.size, true)
+	      && install_page (fr, pg, pg->writable))
+	    {
+	      frame_check_in (fr);
+	    }
+	  else
+	    {
+	      frame_free (fr);
+	    }
+	  page_check_in (m->proc, pg->user_address);
+	}
+      if (buf != NULL)
+	{
+	  palloc_free_multiple (buf, n);
 	}
-      free (mp);
     }
-  lock_release (&proc->mapping_table_lock);
 }
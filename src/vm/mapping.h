@@ -9,18 +9,24 @@
 #define SRC_VM_MAPPING_H_
 
 #include "hash.h"
+#include "list.h"
 #include "lib/user/syscall.h"
 #include "filesys/file.h"
 
 struct mapping
 {
   struct hash_elem h_elem;
+  struct list_elem l_elem; /* Element in the flusher's list */
   mapid_t map_id;
   void *upage;
   int num_pages;
+  struct file *file;
   struct process *proc;
 };
 
+void
+mapping_init (void);
+
 bool
 mapping_table_init (struct hash **mapping_table);
 
@@ -30,7 +36,16 @@ mapping_table_destroy (struct process *proc);
 struct mapping*
 mapping_alloc (struct process *proc, void *upage, struct file *f);
 
+struct mapping*
+mapping_alloc_anon (struct process *proc, void *upage, size_t length);
+
 void
 mapping_free (struct process *proc, mapid_t map_id);
 
+void
+mapping_populate (struct mapping *m);
+
+bool
+mapping_sync (struct process *proc, mapid_t map_id);
+
 #endif /* SRC_VM_MAPPING_H_ */
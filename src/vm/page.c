@@ -8,31 +8,100 @@
 #include "debug.h"
 #include "frame.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
 #include "threads/thread.h"
 #include "userprog/process.h"
 #include "userprog/pagedir.h"
+#include "round.h"
+#include "bitmap.h"
 #include "string.h"
 #include "threads/vaddr.h"
 #include "swap.h"
+#include "vmstat.h"
 #include "page.h"
 
 extern struct lock lock_file_sys;
 
+/* Most pages a process may lock with mlock(), so that locked memory
+ cannot starve the evictor. */
+#define MLOCK_LIMIT_PAGES 64
+
+/* Cache of struct page, the most numerous object in the kernel. */
+static struct kmem_cache page_slab;
+
+/* Returns the shard of PROC's page table that holds UPAGE.  Neighbouring
+ pages land in different shards, so that a fault on one page does not
+ hold up the prefetcher or the evictor working on the next. */
+static struct page_table_shard*
+page_shard (struct process *proc, const void *upage)
+{
+  return &proc->page_table->shards[pg_no (upage) % PAGE_TABLE_SHARDS];
+}
+
+/* Returns the page at UPAGE in SHARD, or NULL if there is none.  Must be
+ called with SHARD's lock held. */
+static struct page*
+page_find (struct page_table_shard *shard, void *upage)
+{
+  struct page p;
+  struct hash_elem *e;
+  p.user_address = upage;
+  e = hash_find (&shard->pages, &p.h_elem);
+  return e != NULL ? hash_entry(e, struct page, h_elem) : NULL;
+}
+
+/* Waits until the page at UPAGE in SHARD is checked in, checks it out
+ and removes it from SHARD.  Returns the page, or NULL if there is
+ none.  Must be called with SHARD's lock held, which is released while
+ waiting. */
+static struct page*
+page_remove (struct page_table_shard *shard, void *upage)
+{
+  struct page *pg;
+  while ((pg = page_find (shard, upage)) != NULL && pg->checked_out)
+    {
+      cond_wait (&shard->checked_in, &shard->lock);
+    }
+  if (pg != NULL)
+    {
+      pg->checked_out = true;
+      hash_delete (&shard->pages, &pg->h_elem);
+    }
+  return pg;
+}
+
+/* Releases the frame or swap slot of PG, which has been removed from its
+ page table, and frees it.  Dirty pages of private file mappings are
+ written back first; shared frames are written back by
+ frame_release(). */
 static void
-page_deallocate (struct hash_elem *e, void *aux UNUSED)
+page_destroy (struct page *pg)
 {
-  struct page *p = hash_entry(e, struct page, h_elem);
-  ASSERT(p != NULL);
-  sema_down (&p->page_sema);
-  if (p->f != NULL)
+  if (pg->locked)
     {
-      frame_free (p->f->kernel_address, false);
+      pg->proc->locked_cnt--;
     }
-  else if (p->type == PAGE_TYPE_SWAP)
+  if (pg->f != NULL)
     {
-      swap_free (p->ps.swap_sector);
+      if (pg->type == PAGE_TYPE_FILE && !pg->ps.fs.read_only
+	  && pg->f->inode == NULL
+	  && pagedir_is_dirty (pg->pagedir, pg->user_address))
+	{
+	  lock_acquire (&lock_file_sys);
+	  ASSERT(
+	      file_write_at (pg->ps.fs.f, pg->f->kernel_address, pg->ps.fs.size,
+			     pg->ps.fs.offset) == pg->ps.fs.size);
+	  lock_release (&lock_file_sys);
+	  VMSTAT_INC(writebacks);
+	}
+      pagedir_clear_page (pg->pagedir, pg->user_address);
+      frame_release (pg->f, pg);
     }
-  free (p);
+  else if (pg->type == PAGE_TYPE_SWAP)
+    {
+      swap_free (pg->ps.swap_sector);
+    }
+  kmem_cache_free (&page_slab, pg);
 }
 
 static unsigned
@@ -52,23 +121,64 @@ page_less (const struct hash_elem *a_, const struct hash_elem *b_,
   return a->user_address < b->user_address;
 }
 
+void
+page_init (void)
+{
+  kmem_cache_init (&page_slab, "page", sizeof(struct page), NULL);
+}
+
 bool
-page_table_init (struct hash **page_table)
+page_table_init (struct page_table **page_table)
 {
   ASSERT(page_table != NULL);
-  *page_table = (struct hash*) malloc (sizeof(struct hash));
+  *page_table = (struct page_table*) malloc (sizeof(struct page_table));
   if (*page_table == NULL)
     {
       return false;
     }
-  return hash_init (*page_table, page_hash, page_less, NULL);
+  for (int i = 0; i < PAGE_TABLE_SHARDS; i++)
+    {
+      struct page_table_shard *shard = &(*page_table)->shards[i];
+      if (!hash_init (&shard->pages, page_hash, page_less, NULL))
+	{
+	  while (i-- > 0)
+	    {
+	      hash_destroy (&(*page_table)->shards[i].pages, NULL);
+	    }
+	  free (*page_table);
+	  return false;
+	}
+      lock_init (&shard->lock);
+      cond_init (&shard->checked_in);
+    }
+  return true;
 }
 
 void
 page_table_destroy (struct process *proc)
 {
-  sema_down (&proc->page_table_sema);
-  hash_destroy (proc->page_table, page_deallocate);
+  for (int i = 0; i < PAGE_TABLE_SHARDS; i++)
+    {
+      struct page_table_shard *shard = &proc->page_table->shards[i];
+      lock_acquire (&shard->lock);
+      while (!hash_empty (&shard->pages))
+	{
+	  struct hash_iterator it;
+	  hash_first (&it, &shard->pages);
+	  hash_next (&it);
+	  void *upage = hash_entry(hash_cur (&it), struct page,
+				   h_elem)->user_address;
+	  struct page *pg = page_remove (shard, upage);
+	  if (pg != NULL)
+	    {
+	      lock_release (&shard->lock);
+	      page_destroy (pg);
+	      lock_acquire (&shard->lock);
+	    }
+	}
+      lock_release (&shard->lock);
+      hash_destroy (&shard->pages, NULL);
+    }
   free (proc->page_table);
 }
 
@@ -83,25 +193,30 @@ page_alloc_and_check_out (struct process *proc, void *upage, uint32_t *pd,
   ASSERT(proc != NULL);
   ASSERT(pd != NULL);
   ASSERT(is_user_vaddr (upage));
-  struct page *pg = (struct page*) malloc (sizeof(struct page));
+  struct page *pg = (struct page*) kmem_cache_alloc (&page_slab);
   ASSERT(pg != NULL);
   pg->proc = proc;
   pg->user_address = upage;
   pg->type = type;
   pg->writable = writable;
   pg->f = NULL;
+  pg->pin_cnt = 0;
+  pg->locked = false;
+  pg->referenced = false;
+  pg->checked_out = true;
+  pg->evicting = false;
   pg->pagedir = pd;
   memset (&pg->ps, 0, sizeof(union page_storage));
-  sema_init (&pg->page_sema, 1);
-  sema_down (&proc->page_table_sema);
-  if (hash_insert (proc->page_table, &pg->h_elem) != NULL) // Page already exists
+  struct page_table_shard *shard = page_shard (proc, upage);
+  lock_acquire (&shard->lock);
+  bool inserted = hash_insert (&shard->pages, &pg->h_elem) == NULL;
+  lock_release (&shard->lock);
+  if (!inserted)
     {
-      sema_up (&proc->page_table_sema);
-      free (pg);
+      // Page already exists
+      kmem_cache_free (&page_slab, pg);
       return NULL;
     }
-  sema_down (&pg->page_sema);
-  sema_up (&proc->page_table_sema);
   return pg;
 }
 
@@ -114,29 +229,20 @@ page_free (struct process *proc, void *upage)
     }
   ASSERT(proc != NULL);
   ASSERT(is_user_vaddr (upage));
-  struct page p;
-  struct hash_elem *e;
-  p.user_address = upage;
-  sema_down (&proc->page_table_sema);
-  e = hash_find (proc->page_table, &p.h_elem);
-  if (e != NULL)
-    {
-      struct page *g = hash_entry(e, struct page, h_elem);
-      sema_down (&g->page_sema);
-      hash_delete (proc->page_table, &g->h_elem);
-      if (g->f != NULL)
-	{
-	  frame_free (g->f->kernel_address, true);
-	}
-      else if (g->type == PAGE_TYPE_SWAP)
-	{
-	  swap_free (g->ps.swap_sector);
-	}
-      free (g);
+  struct page_table_shard *shard = page_shard (proc, upage);
+  lock_acquire (&shard->lock);
+  struct page *pg = page_remove (shard, upage);
+  lock_release (&shard->lock);
+  if (pg != NULL)
+    {
+      page_destroy (pg);
     }
-  sema_up (&proc->page_table_sema);
 }
 
+/* Checks out the page at UPAGE, waiting for whoever has it checked out
+ to check it in, and returns it.  With TRY, returns NULL rather than
+ wait for the page or its shard of the page table, as the evictor must.
+ Returns NULL if there is no page at UPAGE. */
 struct page*
 page_check_out (struct process *proc, void *upage, bool try)
 {
@@ -146,32 +252,33 @@ page_check_out (struct process *proc, void *upage, bool try)
     }
   ASSERT(proc != NULL);
   ASSERT(is_user_vaddr (upage));
-  struct page p;
-  struct hash_elem *e;
-  p.user_address = upage;
-  sema_down (&proc->page_table_sema);
-  e = hash_find (proc->page_table, &p.h_elem);
-  if (e != NULL)
+  struct page_table_shard *shard = page_shard (proc, upage);
+  if (try)
     {
-      struct page *pg = hash_entry(e, struct page, h_elem);
-      bool got_page = false;
-      if (try)
+      if (!lock_try_acquire (&shard->lock))
 	{
-	  got_page = sema_try_down (&pg->page_sema);
+	  return NULL;
 	}
-      else
-	{
-	  sema_down (&pg->page_sema);
-	  got_page = true;
-	}
-      sema_up (&proc->page_table_sema);
-      return got_page ? pg : NULL;
     }
   else
     {
-      sema_up (&proc->page_table_sema);
-      return NULL;
+      lock_acquire (&shard->lock);
+    }
+  struct page *pg;
+  while ((pg = page_find (shard, upage)) != NULL && pg->checked_out && !try)
+    {
+      cond_wait (&shard->checked_in, &shard->lock);
+    }
+  if (pg != NULL && pg->checked_out)
+    {
+      pg = NULL;
+    }
+  else if (pg != NULL)
+    {
+      pg->checked_out = true;
     }
+  lock_release (&shard->lock);
+  return pg;
 }
 
 void
@@ -183,43 +290,91 @@ page_check_in (struct process *proc, void *upage)
     }
   ASSERT(proc != NULL);
   ASSERT(is_user_vaddr (upage));
-  struct page p;
-  struct hash_elem *e;
-  p.user_address = upage;
-  sema_down (&proc->page_table_sema);
-  e = hash_find (proc->page_table, &p.h_elem);
-  if (e != NULL)
+  struct page_table_shard *shard = page_shard (proc, upage);
+  lock_acquire (&shard->lock);
+  struct page *pg = page_find (shard, upage);
+  if (pg != NULL)
+    {
+      ASSERT(pg->checked_out);
+      pg->checked_out = false;
+      cond_broadcast (&shard->checked_in, &shard->lock);
+    }
+  lock_release (&shard->lock);
+}
+
+/* Writes the contents of PG, which is checked out and has just been
+ unmapped, to swap.  If swap is full, maps PG back in, still dirty, and
+ returns false. */
+static bool
+page_swap_out (struct page *pg)
+{
+  block_sector_t sector = swap_write (pg->f->kernel_address);
+  if (sector == BITMAP_ERROR)
     {
-      struct page *pg = hash_entry(e, struct page, h_elem);
-      sema_up (&pg->page_sema);
+      pagedir_set_page (pg->pagedir, pg->user_address, pg->f->kernel_address,
+			pg->writable);
+      pagedir_set_dirty (pg->pagedir, pg->user_address, true);
+      return false;
     }
-  sema_up (&proc->page_table_sema);
+  pg->type = PAGE_TYPE_SWAP;
+  pg->ps.swap_sector = sector;
+  VMSTAT_INC(evict_swap);
+  return true;
 }
 
+/* Returns true if evicting PG would write it to swap or its file. */
 bool
-page_evict (struct process *proc, void *uaddr)
+page_evict_needs_io (const struct page *pg)
+{
+  ASSERT(pg->f != NULL);
+  return pg->type == PAGE_TYPE_SWAP
+      || pagedir_is_dirty (pg->pagedir, pg->user_address);
+}
+
+/* Checks out the page at UADDR and unmaps it from its frame, so that
+ it cannot change any more, as the first half of evicting it.  Its
+ contents stay in the frame until page_evict_finish().  Called by the
+ frame table with the frame checked out.  Returns NULL if the page is
+ busy or not resident. */
+struct page*
+page_evict_start (struct process *proc, void *uaddr)
 {
   if (uaddr == NULL)
     {
-      return false;
+      return NULL;
     }
   ASSERT(proc != NULL);
   ASSERT(is_user_vaddr (uaddr));
   struct page *pg = page_check_out (proc, uaddr, true);
   if (pg == NULL)
     {
-      return false;
+      return NULL;
     }
   if (pg->f == NULL)
     {
       page_check_in (proc, uaddr);
-      return false;
+      return NULL;
     }
+  pagedir_clear_page (pg->pagedir, uaddr);
+  pg->evicting = true;
+  return pg;
+}
+
+/* Saves the contents of PG, unmapped by page_evict_start(), if needed,
+ detaches it from its frame and checks it in.  May run in another
+ thread than page_evict_start() did.  Returns false, leaving PG mapped
+ again, if swap is full. */
+bool
+page_evict_finish (struct page *pg)
+{
+  ASSERT(pg != NULL && pg->checked_out && pg->f != NULL);
   uint32_t *user_pd = pg->pagedir;
-  pagedir_clear_page (user_pd, uaddr);
+  void *uaddr = pg->user_address;
+  pg->evicting = false;
+  bool evicted = true;
   if (pg->type == PAGE_TYPE_SWAP)
     {
-      pg->ps.swap_sector = swap_write (pg->f->kernel_address);
+      evicted = page_swap_out (pg);
     }
   else
     {
@@ -231,8 +386,13 @@ page_evict (struct process *proc, void *uaddr)
 	      {
 		if (pg->ps.fs.read_only)
 		  {
-		    pg->type = PAGE_TYPE_SWAP;
-		    pg->ps.swap_sector = swap_write (pg->f->kernel_address);
+		    evicted = page_swap_out (pg);
+		  }
+		else if (pg->f->inode != NULL)
+		  {
+		    // Written back once its other mappers are gone too
+		    pg->f->dirty = true;
+		    VMSTAT_INC(evict_file);
 		  }
 		else
 		  {
@@ -242,24 +402,56 @@ page_evict (struct process *proc, void *uaddr)
 				       pg->ps.fs.size, pg->ps.fs.offset)
 			    == pg->ps.fs.size);
 		    lock_release (&lock_file_sys);
+		    VMSTAT_INC(evict_file);
+		    VMSTAT_INC(writebacks);
 		  }
 		break;
 	      }
 	    case PAGE_TYPE_ZERO:
-	      pg->type = PAGE_TYPE_SWAP;
-	      pg->ps.swap_sector = swap_write (pg->f->kernel_address);
+	      evicted = page_swap_out (pg);
 	      break;
 	    default:
 	      ASSERT(false)
 	      ;
 	      break;
 	    }
-	  pagedir_set_dirty (user_pd, uaddr, false);
+	  if (evicted)
+	    {
+	      pagedir_set_dirty (user_pd, uaddr, false);
+	    }
+	}
+      else
+	{
+	  VMSTAT_INC(evict_clean);
 	}
     }
-  pg->f = NULL;
-  page_check_in (proc, uaddr);
-  return true;
+  if (evicted)
+    {
+      frame_detach (pg->f, pg);
+    }
+  page_check_in (pg->proc, uaddr);
+  return evicted;
+}
+
+/* Unmaps the page at UADDR from its frame, saving its contents first
+ if needed.  Called by the frame table with the frame checked out;
+ gives up if the page is busy or swap is full. */
+bool
+page_evict (struct process *proc, void *uaddr)
+{
+  struct page *pg = page_evict_start (proc, uaddr);
+  return pg != NULL && page_evict_finish (pg);
+}
+
+/* Returns the page at UPAGE, or NULL if there is none. */
+static struct page*
+page_lookup (struct process *proc, void *upage)
+{
+  struct page_table_shard *shard = page_shard (proc, upage);
+  lock_acquire (&shard->lock);
+  struct page *pg = page_find (shard, upage);
+  lock_release (&shard->lock);
+  return pg;
 }
 
 bool
@@ -268,15 +460,109 @@ page_is_writable (struct process *proc, void *upage)
   ASSERT(upage != NULL);
   ASSERT(is_user_vaddr (upage));
   ASSERT(proc != NULL);
-  struct page p;
-  struct hash_elem *e;
-  p.user_address = upage;
-  sema_down (&proc->page_table_sema);
-  e = hash_find (proc->page_table, &p.h_elem);
-  ASSERT(e != NULL);
-  struct page *pg = hash_entry(e, struct page, h_elem);
+  struct page *pg = page_lookup (proc, upage);
   ASSERT(pg != NULL);
-  bool result = pg->writable;
-  sema_up (&proc->page_table_sema);
-  return result;
+  return pg->writable;
+}
+
+/* Pins the frame of the resident page at UPAGE, which the caller has
+ checked out, so that it stays in memory after being checked in until
+ page_unpin() is called.  Unlike holding the page checked out, this
+ lets other threads use the page and the caller take other locks. */
+void
+page_pin (struct process *proc, void *upage)
+{
+  ASSERT(proc != NULL);
+  struct page *pg = page_lookup (proc, upage);
+  ASSERT(pg != NULL && pg->f != NULL);
+  pg->pin_cnt++;
+  frame_pin (pg->f, 1);
+}
+
+/* Drops a pin taken by page_pin(). */
+void
+page_unpin (struct process *proc, void *upage)
+{
+  ASSERT(proc != NULL);
+  struct page *pg = page_check_out (proc, upage, false);
+  if (pg == NULL)
+    {
+      return;
+    }
+  ASSERT(pg->pin_cnt > 0);
+  pg->pin_cnt--;
+  if (pg->f != NULL)
+    {
+      frame_pin (pg->f, -1);
+    }
+  page_check_in (proc, upage);
+}
+
+/* Brings in and pins the pages spanning LENGTH bytes at ADDR until
+ they are unlocked or freed.  Fails if part of the range is not
+ mapped or the process would exceed MLOCK_LIMIT_PAGES; pages locked
+ before that point stay locked. */
+bool
+page_mlock (struct process *proc, void *addr, size_t length)
+{
+  ASSERT(proc != NULL);
+  void *start = pg_round_down (addr);
+  void *end = (void*) ROUND_UP ((uintptr_t) addr + length, PGSIZE);
+  if (!is_user_vaddr (addr) || end < start || !is_user_vaddr (end - 1))
+    {
+      return false;
+    }
+  for (void *upage = start; upage < end; upage += PGSIZE)
+    {
+      if (!load_page (proc, upage, false, true))
+	{
+	  return false;
+	}
+      struct page *pg = page_lookup (proc, upage);
+      if (!pg->locked)
+	{
+	  if (proc->locked_cnt >= MLOCK_LIMIT_PAGES)
+	    {
+	      page_check_in (proc, upage);
+	      return false;
+	    }
+	  pg->locked = true;
+	  proc->locked_cnt++;
+	  page_pin (proc, upage);
+	}
+      page_check_in (proc, upage);
+    }
+  return true;
+}
+
+/* Unlocks the pages spanning LENGTH bytes at ADDR. */
+void
+page_munlock (struct process *proc, void *addr, size_t length)
+{
+  ASSERT(proc != NULL);
+  void *start = pg_round_down (addr);
+  void *end = (void*) ROUND_UP ((uintptr_t) addr + length, PGSIZE);
+  if (!is_user_vaddr (addr) || end < start || !is_user_vaddr (end - 1))
+    {
+      return;
+    }
+  for (void *upage = start; upage < end; upage += PGSIZE)
+    {
+      struct page *pg = page_check_out (proc, upage, false);
+      if (pg == NULL)
+	{
+	  continue;
+	}
+      if (pg->locked)
+	{
+	  pg->locked = false;
+	  proc->locked_cnt--;
+	  pg->pin_cnt--;
+	  if (pg->f != NULL)
+	    {
+	      frame_pin (pg->f, -1);
+	    }
+	}
+      page_check_in (proc, upage);
+    }
 }
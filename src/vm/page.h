@@ -37,16 +37,43 @@ struct page
   struct hash_elem h_elem;
   struct process *proc;
   void *user_address;
-  struct semaphore page_sema;
+  bool checked_out; /* In use by a thread, see page_check_out() */
+  bool evicting; /* Unmapped by page_evict_start(), not yet saved */
   uint32_t *pagedir;
   struct frame *f;
+  struct list_elem f_elem;
   enum page_type type;
   bool writable;
+  unsigned pin_cnt; /* Pins this page holds on its frame */
+  bool locked; /* Pinned by mlock() */
+  bool referenced; /* Counted in its process's working set */
   union page_storage ps;
 };
 
+#define PAGE_TABLE_SHARDS 16
+
+/* A slice of a supplemental page table.  LOCK is held only to look up,
+ add or remove pages, never while waiting for a checked out page, so
+ faults on different pages do not queue behind each other. */
+struct page_table_shard
+{
+  struct hash pages;
+  struct lock lock;
+  struct condition checked_in; /* Signalled when a page is checked in */
+};
+
+/* Supplemental page table of a process, split into shards by page
+ number. */
+struct page_table
+{
+  struct page_table_shard shards[PAGE_TABLE_SHARDS];
+};
+
+void
+page_init (void);
+
 bool
-page_table_init (struct hash **page_table);
+page_table_init (struct page_table **page_table);
 
 void
 page_table_destroy (struct process *proc);
@@ -64,10 +91,31 @@ page_check_out (struct process *proc, void *upage, bool try);
 void
 page_check_in (struct process *proc, void *upage);
 
+bool
+page_evict_needs_io (const struct page *pg);
+
+struct page*
+page_evict_start (struct process *proc, void *uaddr);
+
+bool
+page_evict_finish (struct page *pg);
+
 bool
 page_evict (struct process *proc, void *uaddr);
 
 bool
 page_is_writable (struct process *proc, void *upage);
 
+void
+page_pin (struct process *proc, void *upage);
+
+void
+page_unpin (struct process *proc, void *upage);
+
+bool
+page_mlock (struct process *proc, void *addr, size_t length);
+
+void
+page_munlock (struct process *proc, void *addr, size_t length);
+
 #endif /* SRC_VM_PAGE_H_ */
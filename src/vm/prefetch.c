@@ -0,0 +1,146 @@
+/*
+ * prefetch.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Beshoy Saad
+ */
+
+#include "debug.h"
+#include "list.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/process.h"
+#include "prefetch.h"
+
+/* Hints beyond this many pending requests are dropped, they are only
+ an optimization. */
+#define PREFETCH_QUEUE_MAX 32
+
+/* Pages of a process to bring in before it touches them. */
+struct prefetch_request
+{
+  struct list_elem elem;
+  struct process *proc;
+  void *upage;
+  size_t page_cnt;
+};
+
+static struct list prefetch_list;
+static size_t prefetch_cnt;
+static struct lock prefetch_lock;
+static struct condition prefetch_ready; /* A request was queued */
+static struct condition prefetch_idle; /* The worker finished a request */
+
+/* Process the worker is loading pages for, and whether it has been
+ asked to stop.  Protected by prefetch_lock. */
+static struct process *busy_proc;
+static bool busy_cancelled;
+
+/* Loads the pages of queued requests one by one, in the background. */
+static void
+prefetch_worker (void *aux UNUSED)
+{
+  lock_acquire (&prefetch_lock);
+  while (true)
+    {
+      while (list_empty (&prefetch_list))
+	{
+	  cond_wait (&prefetch_ready, &prefetch_lock);
+	}
+      struct prefetch_request *req = list_entry(
+	  list_pop_front (&prefetch_list), struct prefetch_request, elem);
+      prefetch_cnt--;
+      busy_proc = req->proc;
+      busy_cancelled = false;
+      lock_release (&prefetch_lock);
+
+      for (size_t i = 0; i < req->page_cnt && !busy_cancelled; i++)
+	{
+	  load_page (req->proc, req->upage + i * PGSIZE, false, false);
+	}
+      free (req);
+
+      lock_acquire (&prefetch_lock);
+      busy_proc = NULL;
+      cond_broadcast (&prefetch_idle, &prefetch_lock);
+    }
+}
+
+void
+prefetch_init (void)
+{
+  list_init (&prefetch_list);
+  prefetch_cnt = 0;
+  lock_init (&prefetch_lock);
+  cond_init (&prefetch_ready);
+  cond_init (&prefetch_idle);
+  busy_proc = NULL;
+  thread_create ("prefetch", PRI_DEFAULT, prefetch_worker, NULL);
+}
+
+/* Asks for PAGE_CNT pages of PROC starting at UPAGE to be loaded
+ asynchronously.  Pages already present, or not part of any region,
+ are skipped. */
+void
+prefetch_queue (struct process *proc, void *upage, size_t page_cnt)
+{
+  ASSERT(proc != NULL);
+  ASSERT(pg_ofs (upage) == 0);
+  if (page_cnt == 0)
+    {
+      return;
+    }
+  struct prefetch_request *req = (struct prefetch_request*) malloc (
+      sizeof(struct prefetch_request));
+  if (req == NULL)
+    {
+      return;
+    }
+  req->proc = proc;
+  req->upage = upage;
+  req->page_cnt = page_cnt;
+  lock_acquire (&prefetch_lock);
+  if (prefetch_cnt < PREFETCH_QUEUE_MAX)
+    {
+      list_push_back (&prefetch_list, &req->elem);
+      prefetch_cnt++;
+      cond_signal (&prefetch_ready, &prefetch_lock);
+      req = NULL;
+    }
+  lock_release (&prefetch_lock);
+  free (req);
+}
+
+/* Drops PROC's pending requests and waits for the worker to stop
+ touching its pages.  Must be called before PROC's address space is
+ torn down. */
+void
+prefetch_cancel (struct process *proc)
+{
+  ASSERT(proc != NULL);
+  lock_acquire (&prefetch_lock);
+  struct list_elem *e = list_begin (&prefetch_list);
+  while (e != list_end (&prefetch_list))
+    {
+      struct prefetch_request *req = list_entry(e, struct prefetch_request,
+						 elem);
+      e = list_next (e);
+      if (req->proc == proc)
+	{
+	  list_remove (&req->elem);
+	  prefetch_cnt--;
+	  free (req);
+	}
+    }
+  if (busy_proc == proc)
+    {
+      busy_cancelled = true;
+      while (busy_proc == proc)
+	{
+	  cond_wait (&prefetch_idle, &prefetch_lock);
+	}
+    }
+  lock_release (&prefetch_lock);
+}
@@ -0,0 +1,24 @@
+/*
+ * prefetch.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Beshoy Saad
+ */
+
+#ifndef SRC_VM_PREFETCH_H_
+#define SRC_VM_PREFETCH_H_
+
+#include <stddef.h>
+
+struct process;
+
+void
+prefetch_init (void);
+
+void
+prefetch_queue (struct process *proc, void *upage, size_t page_cnt);
+
+void
+prefetch_cancel (struct process *proc);
+
+#endif /* SRC_VM_PREFETCH_H_ */
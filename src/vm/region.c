@@ -0,0 +1,592 @@
+/*
+ * region.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Beshoy Saad
+ */
+
+#include "debug.h"
+#include "round.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "userprog/process.h"
+#include <syscall-nr.h>
+#include "prefetch.h"
+#include "swap.h"
+#include "region.h"
+
+/* Regions are kept in an AVL tree ordered by start address, so a
+ fault or an mmap() is O(log n) in the number of regions.  Regions
+ never overlap, which orders their end addresses the same way as their
+ starts.  Stabbing and overlap queries therefore only need the
+ lowest region ending above an address, and the tree does not have to
+ carry the maximum end of each subtree like a general interval tree. */
+
+static int
+region_height (const struct region *r)
+{
+  return r != NULL ? r->height : 0;
+}
+
+static void
+region_update (struct region *r)
+{
+  int lh = region_height (r->left);
+  int rh = region_height (r->right);
+  r->height = (lh > rh ? lh : rh) + 1;
+}
+
+static struct region*
+region_rotate_right (struct region *r)
+{
+  struct region *l = r->left;
+  r->left = l->right;
+  l->right = r;
+  region_update (r);
+  region_update (l);
+  return l;
+}
+
+static struct region*
+region_rotate_left (struct region *r)
+{
+  struct region *rr = r->right;
+  r->right = rr->left;
+  rr->left = r;
+  region_update (r);
+  region_update (rr);
+  return rr;
+}
+
+/* Restores the AVL invariant at R after one of its subtrees changed
+ height by at most one.  Returns the new root of the subtree. */
+static struct region*
+region_balance (struct region *r)
+{
+  region_update (r);
+  int balance = region_height (r->left) - region_height (r->right);
+  if (balance > 1)
+    {
+      if (region_height (r->left->left) < region_height (r->left->right))
+	{
+	  r->left = region_rotate_left (r->left);
+	}
+      return region_rotate_right (r);
+    }
+  if (balance < -1)
+    {
+      if (region_height (r->right->right) < region_height (r->right->left))
+	{
+	  r->right = region_rotate_right (r->right);
+	}
+      return region_rotate_left (r);
+    }
+  return r;
+}
+
+/* Inserts R into the subtree ROOT and returns the new root. */
+static struct region*
+region_insert (struct region *root, struct region *r)
+{
+  if (root == NULL)
+    {
+      r->left = r->right = NULL;
+      r->height = 1;
+      return r;
+    }
+  if (r->start < root->start)
+    {
+      root->left = region_insert (root->left, r);
+    }
+  else
+    {
+      root->right = region_insert (root->right, r);
+    }
+  return region_balance (root);
+}
+
+/* Unlinks the lowest region of the subtree ROOT, stores it in *MIN and
+ returns the new root. */
+static struct region*
+region_unlink_min (struct region *root, struct region **min)
+{
+  if (root->left == NULL)
+    {
+      *min = root;
+      return root->right;
+    }
+  root->left = region_unlink_min (root->left, min);
+  return region_balance (root);
+}
+
+/* Unlinks R, which must be in the subtree ROOT, and returns the new
+ root. */
+static struct region*
+region_unlink (struct region *root, struct region *r)
+{
+  ASSERT(root != NULL);
+  if (r->start < root->start)
+    {
+      root->left = region_unlink (root->left, r);
+    }
+  else if (r->start > root->start)
+    {
+      root->right = region_unlink (root->right, r);
+    }
+  else
+    {
+      if (root->right == NULL)
+	{
+	  return root->left;
+	}
+      struct region *min;
+      struct region *right = region_unlink_min (root->right, &min);
+      min->left = root->left;
+      min->right = right;
+      root = min;
+    }
+  return region_balance (root);
+}
+
+/* Frees every region of the subtree ROOT. */
+static void
+region_free_all (struct region *root)
+{
+  if (root != NULL)
+    {
+      region_free_all (root->left);
+      region_free_all (root->right);
+      free (root);
+    }
+}
+
+/* Returns the region containing UADDR or, if there is none, the first
+ region above it.  Returns NULL if no region ends above UADDR.  Must be
+ called with the process's region_lock held. */
+static struct region*
+region_ceiling (struct process *proc, const void *uaddr)
+{
+  struct region *best = NULL;
+  struct region *r = proc->region_root;
+  while (r != NULL)
+    {
+      if (uaddr < r->end)
+	{
+	  best = r;
+	  if (uaddr >= r->start)
+	    {
+	      break;
+	    }
+	  r = r->left;
+	}
+      else
+	{
+	  r = r->right;
+	}
+    }
+  return best;
+}
+
+/* Returns the region following R in address order, or NULL.  Must be
+ called with the process's region_lock held. */
+static struct region*
+region_next (struct process *proc, const struct region *r)
+{
+  return region_ceiling (proc, r->end);
+}
+
+/* Returns the region containing UADDR.
+ Must be called with the process's region_lock held. */
+static struct region*
+region_lookup (struct process *proc, const void *uaddr)
+{
+  struct region *r = region_ceiling (proc, uaddr);
+  return r != NULL && r->start <= uaddr ? r : NULL;
+}
+
+/* Returns true if any region overlaps [START, END).
+ Must be called with the process's region_lock held. */
+static bool
+region_overlaps (struct process *proc, const void *start, const void *end)
+{
+  struct region *r = region_ceiling (proc, start);
+  return r != NULL && r->start < end;
+}
+
+/* Returns the number of pages of R that would go to swap if dirtied
+ and evicted, which need reserving.  Stack pages are reserved one by
+ one as the stack grows. */
+static size_t
+region_anon_pages (const struct region *r)
+{
+  if (!r->writable || (r->file != NULL && !r->read_only)
+      || r->type == REGION_STACK)
+    {
+      return 0;
+    }
+  return (r->end - r->start) / PGSIZE;
+}
+
+/* Reserves swap for PAGE_CNT anonymous pages of PROC.  Must be called
+ with the process's region_lock held. */
+static bool
+region_reserve_locked (struct process *proc, size_t page_cnt)
+{
+  if (!swap_reserve (page_cnt))
+    {
+      return false;
+    }
+  proc->committed += page_cnt;
+  return true;
+}
+
+/* Gives back PAGE_CNT pages reserved for PROC.  Must be called with the
+ process's region_lock held. */
+static void
+region_unreserve_locked (struct process *proc, size_t page_cnt)
+{
+  ASSERT(proc->committed >= page_cnt);
+  swap_unreserve (page_cnt);
+  proc->committed -= page_cnt;
+}
+
+void
+region_table_init (struct process *proc)
+{
+  ASSERT(proc != NULL);
+  proc->region_root = NULL;
+  lock_init (&proc->region_lock);
+}
+
+void
+region_table_destroy (struct process *proc)
+{
+  ASSERT(proc != NULL);
+  lock_acquire (&proc->region_lock);
+  region_free_all (proc->region_root);
+  proc->region_root = NULL;
+  region_unreserve_locked (proc, proc->committed);
+  lock_release (&proc->region_lock);
+}
+
+/* Reserves swap for PAGE_CNT more pages of PROC's anonymous memory,
+ such as a page of stack.  Returns false if the OOM policy refuses. */
+bool
+region_reserve (struct process *proc, size_t page_cnt)
+{
+  ASSERT(proc != NULL);
+  lock_acquire (&proc->region_lock);
+  bool success = region_reserve_locked (proc, page_cnt);
+  lock_release (&proc->region_lock);
+  return success;
+}
+
+/* Gives back a reservation made by region_reserve(). */
+void
+region_unreserve (struct process *proc, size_t page_cnt)
+{
+  ASSERT(proc != NULL);
+  lock_acquire (&proc->region_lock);
+  region_unreserve_locked (proc, page_cnt);
+  lock_release (&proc->region_lock);
+}
+
+/* Describes READ_BYTES + ZERO_BYTES bytes of memory at UPAGE, the first
+ READ_BYTES of which are read from FILE starting at OFS.  No page is
+ allocated until it is touched, but swap is reserved for the pages
+ that may need it.  Fails if UPAGE is not page aligned, the range
+ overlaps an existing region or swap cannot be reserved. */
+bool
+region_add (struct process *proc, enum region_type type, void *upage,
+	    uint32_t *pd, struct file *file, off_t ofs, uint32_t read_bytes,
+	    uint32_t zero_bytes, bool writable, bool read_only)
+{
+  ASSERT(proc != NULL);
+  ASSERT((read_bytes + zero_bytes) % PGSIZE == 0);
+  ASSERT(ofs % PGSIZE == 0);
+  if (upage == NULL || pg_ofs (upage) != 0)
+    {
+      return false;
+    }
+  void *end = upage + read_bytes + zero_bytes;
+  if (end <= upage || !is_user_vaddr (end - 1))
+    {
+      return false;
+    }
+
+  struct region *r = (struct region*) malloc (sizeof(struct region));
+  if (r == NULL)
+    {
+      return false;
+    }
+  r->type = type;
+  r->start = upage;
+  r->end = end;
+  r->pagedir = pd;
+  r->file = file;
+  r->offset = ofs;
+  r->read_bytes = read_bytes;
+  r->writable = writable;
+  r->read_only = read_only;
+  r->advice = MADV_NORMAL;
+
+  lock_acquire (&proc->region_lock);
+  if (region_overlaps (proc, r->start, r->end)
+      || !region_reserve_locked (proc, region_anon_pages (r)))
+    {
+      lock_release (&proc->region_lock);
+      free (r);
+      return false;
+    }
+  proc->region_root = region_insert (proc->region_root, r);
+  lock_release (&proc->region_lock);
+  return true;
+}
+
+/* Forgets the region starting at UPAGE.  Its pages must already have
+ been freed. */
+void
+region_remove (struct process *proc, void *upage)
+{
+  ASSERT(proc != NULL);
+  lock_acquire (&proc->region_lock);
+  struct region *r = region_lookup (proc, upage);
+  if (r != NULL && r->start == upage)
+    {
+      proc->region_root = region_unlink (proc->region_root, r);
+      region_unreserve_locked (proc, region_anon_pages (r));
+      free (r);
+    }
+  lock_release (&proc->region_lock);
+}
+
+/* Checks out the page at UPAGE, first creating it from its region's
+ description if it has never been touched.  Stack pages are only
+ created by grow_stack().  Returns NULL if UPAGE is not mapped. */
+struct page*
+region_page_check_out (struct process *proc, void *upage)
+{
+  ASSERT(proc != NULL);
+  ASSERT(pg_ofs (upage) == 0);
+  struct page *pg = page_check_out (proc, upage, false);
+  if (pg != NULL)
+    {
+      return pg;
+    }
+
+  lock_acquire (&proc->region_lock);
+  struct region *r = region_lookup (proc, upage);
+  if (r != NULL && r->type != REGION_STACK)
+    {
+      uint32_t ofs = upage - r->start;
+      uint32_t page_read_bytes = 0;
+      if (ofs < r->read_bytes)
+	{
+	  page_read_bytes = r->read_bytes - ofs;
+	  if (page_read_bytes > PGSIZE)
+	    {
+	      page_read_bytes = PGSIZE;
+	    }
+	}
+      pg = page_alloc_and_check_out (
+	  proc, upage, r->pagedir,
+	  page_read_bytes > 0 ? PAGE_TYPE_FILE : PAGE_TYPE_ZERO, r->writable);
+      if (pg == NULL)
+	{
+	  // Someone else created it in the meantime
+	  pg = page_check_out (proc, upage, false);
+	}
+      else if (page_read_bytes > 0)
+	{
+	  pg->ps.fs.f = r->file;
+	  pg->ps.fs.size = page_read_bytes;
+	  pg->ps.fs.offset = r->offset + ofs;
+	  pg->ps.fs.read_only = r->read_only;
+	}
+    }
+  lock_release (&proc->region_lock);
+  return pg;
+}
+
+/* Moves the process's program break by INCREMENT bytes, growing or
+ shrinking the heap region that starts right after its data segment.
+ New heap pages are zero-filled on first touch and pages given back are
+ freed immediately.  Returns the previous break, or (void *) -1 if the
+ heap would run into another region or below its start. */
+void*
+region_sbrk (struct process *proc, intptr_t increment)
+{
+  ASSERT(proc != NULL);
+  void *old_brk = proc->brk;
+  void *new_brk = old_brk + increment;
+  if ((increment > 0 && new_brk < old_brk)
+      || (increment < 0 && (new_brk > old_brk || new_brk < proc->heap_start)))
+    {
+      return (void*) -1;
+    }
+
+  void *old_end = (void*) ROUND_UP ((uintptr_t) old_brk, PGSIZE);
+  void *new_end = (void*) ROUND_UP ((uintptr_t) new_brk, PGSIZE);
+  if (new_end == old_end)
+    {
+      proc->brk = new_brk;
+      return old_brk;
+    }
+
+  lock_acquire (&proc->region_lock);
+  struct region *heap = region_lookup (proc, proc->heap_start);
+  if (heap != NULL && heap->type != REGION_HEAP)
+    {
+      lock_release (&proc->region_lock);
+      return (void*) -1;
+    }
+  if (new_end > old_end)
+    {
+      // Grow, as long as we do not run into the next region
+      if (region_overlaps (proc, old_end, new_end)
+	  || !is_user_vaddr (new_end - 1))
+	{
+	  lock_release (&proc->region_lock);
+	  return (void*) -1;
+	}
+      if (heap != NULL)
+	{
+	  if (!region_reserve_locked (proc, (new_end - old_end) / PGSIZE))
+	    {
+	      lock_release (&proc->region_lock);
+	      return (void*) -1;
+	    }
+	  heap->end = new_end;
+	}
+      lock_release (&proc->region_lock);
+      if (heap == NULL
+	  && !region_add (proc, REGION_HEAP, old_end, thread_current ()->pagedir,
+			  NULL, 0, 0, new_end - old_end, true, false))
+	{
+	  return (void*) -1;
+	}
+    }
+  else
+    {
+      // Shrink, no new faults may land in the released pages
+      ASSERT(heap != NULL);
+      region_unreserve_locked (proc, (old_end - new_end) / PGSIZE);
+      if (new_end == heap->start)
+	{
+	  proc->region_root = region_unlink (proc->region_root, heap);
+	  free (heap);
+	}
+      else
+	{
+	  heap->end = new_end;
+	}
+      lock_release (&proc->region_lock);
+      size_t page_cnt = (old_end - new_end) / PGSIZE;
+      pagedir_clear_pages (thread_current ()->pagedir, new_end, page_cnt);
+      for (size_t i = 0; i < page_cnt; i++)
+	{
+	  page_free (proc, new_end + i * PGSIZE);
+	}
+    }
+  proc->brk = new_brk;
+  return old_brk;
+}
+
+/* Applies madvise() ADVICE to the LENGTH bytes at ADDR, which must be
+ page aligned and entirely covered by regions.  SEQUENTIAL, RANDOM and
+ NORMAL are remembered by every region the range touches.  WILLNEED
+ queues the range for prefetching and DONTNEED frees its pages right
+ away, so the next access sees the backing file or zeros again.  The
+ stack has no backing store to fall back to, so DONTNEED skips it. */
+bool
+region_advise (struct process *proc, void *addr, size_t length, int advice)
+{
+  ASSERT(proc != NULL);
+  if (pg_ofs (addr) != 0 || length == 0 || length > (size_t) PHYS_BASE)
+    {
+      return false;
+    }
+  void *end = addr + ROUND_UP (length, PGSIZE);
+  if (end <= addr || !is_user_vaddr (end - 1))
+    {
+      return false;
+    }
+
+  lock_acquire (&proc->region_lock);
+  void *covered = addr;
+  void *stack_start = end;
+  struct region *r;
+  for (r = region_ceiling (proc, addr); r != NULL && covered < end;
+      r = region_next (proc, r))
+    {
+      if (r->start > covered)
+	{
+	  break;
+	}
+      if (r->type == REGION_STACK)
+	{
+	  stack_start = covered;
+	}
+      covered = r->end;
+    }
+  if (covered < end)
+    {
+      lock_release (&proc->region_lock);
+      return false;
+    }
+  if (advice == MADV_NORMAL || advice == MADV_RANDOM
+      || advice == MADV_SEQUENTIAL)
+    {
+      for (r = region_ceiling (proc, addr); r != NULL && r->start < end;
+	  r = region_next (proc, r))
+	{
+	  r->advice = advice;
+	}
+    }
+  lock_release (&proc->region_lock);
+
+  switch (advice)
+    {
+    case MADV_NORMAL:
+    case MADV_RANDOM:
+    case MADV_SEQUENTIAL:
+      return true;
+    case MADV_WILLNEED:
+      prefetch_queue (proc, addr, (end - addr) / PGSIZE);
+      return true;
+    case MADV_DONTNEED:
+      {
+	// The stack is always the topmost region
+	size_t page_cnt = (stack_start - addr) / PGSIZE;
+	pagedir_clear_pages (thread_current ()->pagedir, addr, page_cnt);
+	for (size_t i = 0; i < page_cnt; i++)
+	  {
+	    page_free (proc, addr + i * PGSIZE);
+	  }
+	return true;
+      }
+    default:
+      return false;
+    }
+}
+
+/* Returns the madvise() hint for the region containing UADDR, and
+ stores the end of that region in *END. */
+int
+region_advice (struct process *proc, const void *uaddr, void **end)
+{
+  ASSERT(proc != NULL);
+  int advice = MADV_NORMAL;
+  *end = (void*) uaddr;
+  lock_acquire (&proc->region_lock);
+  struct region *r = region_lookup (proc, uaddr);
+  if (r != NULL)
+    {
+      advice = r->advice;
+      *end = r->end;
+    }
+  lock_release (&proc->region_lock);
+  return advice;
+}
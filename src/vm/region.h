@@ -0,0 +1,74 @@
+/*
+ * region.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Beshoy Saad
+ */
+
+#ifndef SRC_VM_REGION_H_
+#define SRC_VM_REGION_H_
+
+#include "stdint.h"
+#include "filesys/file.h"
+#include "page.h"
+
+enum region_type
+{
+  REGION_SEGMENT, /* Executable segment */
+  REGION_STACK, /* User stack, grown page by page */
+  REGION_HEAP, /* Anonymous memory grown and shrunk by sbrk() */
+  REGION_MMAP /* Memory mapped file or anonymous memory */
+};
+
+/* A contiguous range of user pages sharing one backing store.  Pages
+ are only given a struct page once they are first touched. */
+struct region
+{
+  struct region *left; /* Regions below START */
+  struct region *right; /* Regions above START */
+  int height; /* Height of the subtree rooted here */
+  enum region_type type;
+  void *start; /* First page of the region */
+  void *end; /* One past the last page of the region */
+  uint32_t *pagedir; /* Page directory the region is mapped into */
+  struct file *file; /* Backing file, NULL if zero-filled */
+  off_t offset; /* Offset in FILE of START */
+  uint32_t read_bytes; /* Bytes read from FILE, the rest is zeroed */
+  bool writable;
+  bool read_only; /* Dirty pages go to swap rather than FILE */
+  int advice; /* Access pattern hint from madvise(), MADV_* */
+};
+
+void
+region_table_init (struct process *proc);
+
+void
+region_table_destroy (struct process *proc);
+
+bool
+region_reserve (struct process *proc, size_t page_cnt);
+
+void
+region_unreserve (struct process *proc, size_t page_cnt);
+
+bool
+region_add (struct process *proc, enum region_type type, void *upage,
+	    uint32_t *pd, struct file *file, off_t ofs, uint32_t read_bytes,
+	    uint32_t zero_bytes, bool writable, bool read_only);
+
+void
+region_remove (struct process *proc, void *upage);
+
+struct page*
+region_page_check_out (struct process *proc, void *upage);
+
+void*
+region_sbrk (struct process *proc, intptr_t increment);
+
+bool
+region_advise (struct process *proc, void *addr, size_t length, int advice);
+
+int
+region_advice (struct process *proc, const void *uaddr, void **end);
+
+#endif /* SRC_VM_REGION_H_ */
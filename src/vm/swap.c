@@ -6,67 +6,267 @@
  */
 
 #include "debug.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
 #include "threads/malloc.h"
+#include "threads/palloc.h"
 #include "threads/thread.h"
 #include "userprog/process.h"
 #include "bitmap.h"
 #include "threads/vaddr.h"
 #include "swap.h"
+#include "zswap.h"
 
-struct block *swap_block = NULL;
-struct bitmap *swap_bm = NULL;
+/* Swap slots held by the compressed pool rather than the disk are
+ marked with this bit. */
+#define ZSWAP_SECTOR 0x80000000
+
+/* Otherwise the bits below it hold the index of the swap device and
+ the first sector of the slot on that device. */
+#define SWAP_MAX_DEVICES 8
+#define SWAP_DEVICE_SHIFT 28
+#define SWAP_SECTOR_MASK ((1u << SWAP_DEVICE_SHIFT) - 1)
+
+#define PAGE_SECTORS (PGSIZE / BLOCK_SECTOR_SIZE)
+
+/* Consecutive pages written to one device before moving on to the
+ next device of the same priority, so that each disk still sees
+ mostly sequential writes. */
+#define SWAP_CLUSTER_PAGES 8
+
+/* A block device used for swap.  Devices are kept sorted by
+ decreasing priority; a device is only written to once every device
+ of higher priority is full, and devices of equal priority take turns
+ a cluster at a time. */
+struct swap_device
+{
+  struct block *block;
+  struct bitmap *slots; /* Page slots in use */
+  int prio;
+  size_t group_end; /* One past the last device of the same priority */
+};
+
+static struct swap_device swap_devices[SWAP_MAX_DEVICES];
+static size_t swap_device_cnt;
+
+/* Device of each priority group to write to next, and how many more
+ pages go to it before the next one takes over.  Indexed by the first
+ device of the group. */
+static size_t swap_rotor[SWAP_MAX_DEVICES];
+static size_t swap_cluster_left[SWAP_MAX_DEVICES];
+
+/* Page slots on all devices, and how many of them are in use. */
+static size_t swap_slot_cnt;
+static size_t swap_used_cnt;
+
+/* Pages of anonymous memory processes have been promised.  Any of
+ them may have to go to swap, so under OOM_FAIL their number is kept
+ below swap_slot_cnt plus the user pool, and swap_write() only fails
+ when file pages crowd the anonymous ones out of memory. */
+static size_t swap_committed_cnt;
+
+enum oom_policy oom_policy = OOM_FAIL;
+
+/* Protects the slot bitmaps, the rotors and the counts above. */
 struct lock swap_table_lock;
 
+/* Adds BLOCK to the swap devices with priority PRIO, keeping them
+ sorted by priority. */
 static void
-swap_free_internal (block_sector_t sector)
+swap_add_device (struct block *block, int prio)
 {
-  ASSERT(sector <= (block_size (swap_block) - 8));
-  ASSERT(bitmap_all (swap_bm, sector, 8));
-  bitmap_set_multiple (swap_bm, sector, 8, false);
+  for (size_t i = 0; i < swap_device_cnt; i++)
+    {
+      if (swap_devices[i].block == block)
+	{
+	  return;
+	}
+    }
+  if (swap_device_cnt == SWAP_MAX_DEVICES)
+    {
+      printf ("swap: too many devices, ignoring %s\n", block_name (block));
+      return;
+    }
+  size_t slot_cnt = block_size (block) / PAGE_SECTORS;
+  if (slot_cnt > (SWAP_SECTOR_MASK + 1) / PAGE_SECTORS)
+    {
+      slot_cnt = (SWAP_SECTOR_MASK + 1) / PAGE_SECTORS;
+    }
+  struct bitmap *slots = bitmap_create (slot_cnt);
+  ASSERT(slots != NULL);
+
+  size_t i = swap_device_cnt++;
+  while (i > 0 && swap_devices[i - 1].prio < prio)
+    {
+      swap_devices[i] = swap_devices[i - 1];
+      i--;
+    }
+  swap_devices[i].block = block;
+  swap_devices[i].slots = slots;
+  swap_devices[i].prio = prio;
+  swap_slot_cnt += slot_cnt;
+  printf ("swap: using %s, %zu pages, priority %d\n", block_name (block),
+	  slot_cnt, prio);
 }
 
+/* Sets up swapping to the devices listed in NAMES, a comma separated
+ list of block device names each optionally followed by ":PRIO", or to
+ every swap partition with equal priority if NAMES is NULL. */
 void
-swap_table_init (void)
+swap_table_init (char *names)
 {
-  swap_block = block_get_role (BLOCK_SWAP);
-  ASSERT(swap_block != NULL);
-  swap_bm = bitmap_create (block_size (swap_block));
-  ASSERT(swap_bm != NULL);
+  if (names != NULL)
+    {
+      char *save_ptr;
+      for (char *name = strtok_r (names, ",", &save_ptr); name != NULL;
+	  name = strtok_r (NULL, ",", &save_ptr))
+	{
+	  char *prio = strchr (name, ':');
+	  if (prio != NULL)
+	    {
+	      *prio++ = '\0';
+	    }
+	  struct block *block = block_get_by_name (name);
+	  if (block == NULL)
+	    {
+	      PANIC("No such block device \"%s\"", name);
+	    }
+	  swap_add_device (block, prio != NULL ? atoi (prio) : 0);
+	}
+    }
+  else
+    {
+      for (struct block *block = block_first (); block != NULL; block =
+	  block_next (block))
+	{
+	  if (block_type (block) == BLOCK_SWAP)
+	    {
+	      swap_add_device (block, 0);
+	    }
+	}
+    }
+  ASSERT(swap_device_cnt > 0);
+
+  // Find the priority groups
+  for (size_t start = 0, end; start < swap_device_cnt; start = end)
+    {
+      for (end = start; end < swap_device_cnt; end++)
+	{
+	  if (swap_devices[end].prio != swap_devices[start].prio)
+	    {
+	      break;
+	    }
+	}
+      for (size_t i = start; i < end; i++)
+	{
+	  swap_devices[i].group_end = end;
+	}
+      swap_rotor[start] = start;
+      swap_cluster_left[start] = SWAP_CLUSTER_PAGES;
+    }
   lock_init (&swap_table_lock);
+  zswap_init ();
+}
+
+/* Takes a free slot on the highest priority device that has one, and
+ returns its index in *DEV.  Returns BITMAP_ERROR if all are full.
+ Must be called with swap_table_lock held. */
+static size_t
+swap_slot_alloc (size_t *dev)
+{
+  for (size_t start = 0; start < swap_device_cnt;
+      start = swap_devices[start].group_end)
+    {
+      size_t end = swap_devices[start].group_end;
+      size_t d = swap_rotor[start];
+      for (size_t tries = start; tries < end; tries++)
+	{
+	  size_t slot = bitmap_scan_and_flip (swap_devices[d].slots, 0, 1,
+					      false);
+	  if (slot != BITMAP_ERROR)
+	    {
+	      if (d != swap_rotor[start])
+		{
+		  // The rotor's device is full, start a cluster on this one
+		  swap_rotor[start] = d;
+		  swap_cluster_left[start] = SWAP_CLUSTER_PAGES;
+		}
+	      if (--swap_cluster_left[start] == 0)
+		{
+		  // Move on to the next device of the group
+		  swap_rotor[start] = d + 1 < end ? d + 1 : start;
+		  swap_cluster_left[start] = SWAP_CLUSTER_PAGES;
+		}
+	      *dev = d;
+	      swap_used_cnt++;
+	      return slot;
+	    }
+	  d = d + 1 < end ? d + 1 : start;
+	}
+    }
+  return BITMAP_ERROR;
+}
+
+/* Releases the slot of swap sector SECTOR, which must be on a device.
+ Must be called with swap_table_lock held. */
+static void
+swap_free_internal (block_sector_t sector)
+{
+  size_t dev = sector >> SWAP_DEVICE_SHIFT;
+  size_t slot = (sector & SWAP_SECTOR_MASK) / PAGE_SECTORS;
+  ASSERT(dev < swap_device_cnt);
+  ASSERT(bitmap_test (swap_devices[dev].slots, slot));
+  bitmap_reset (swap_devices[dev].slots, slot);
+  swap_used_cnt--;
 }
 
+/* Writes the page at KADDR to swap and returns where it went, or
+ BITMAP_ERROR if swap is full. */
 block_sector_t
 swap_write (void *kaddr)
 {
   ASSERT(is_kernel_vaddr (kaddr));
-  block_sector_t s = BITMAP_ERROR;
+  size_t slot = zswap_store (kaddr);
+  if (slot != BITMAP_ERROR)
+    {
+      return ZSWAP_SECTOR | slot;
+    }
+  size_t dev;
   lock_acquire (&swap_table_lock);
-  s = bitmap_scan_and_flip (swap_bm, 0, 8, false);
+  slot = swap_slot_alloc (&dev);
   lock_release (&swap_table_lock);
-  if (s == BITMAP_ERROR)
+  if (slot == BITMAP_ERROR)
     {
-      PANIC("Out of swap slots");
+      return BITMAP_ERROR;
     }
-  ASSERT(s <= (block_size (swap_block) - 8));
-  ASSERT((s * BLOCK_SECTOR_SIZE) % PGSIZE == 0);
-  for (int i = 0; i < 8; i++)
+  block_sector_t s = slot * PAGE_SECTORS;
+  for (int i = 0; i < PAGE_SECTORS; i++)
     {
-      block_write (swap_block, s + i, kaddr + (i * BLOCK_SECTOR_SIZE));
+      block_write (swap_devices[dev].block, s + i,
+		   kaddr + (i * BLOCK_SECTOR_SIZE));
     }
-  return s;
+  return (dev << SWAP_DEVICE_SHIFT) | s;
 }
 
 void
 swap_read (block_sector_t sector, void *kaddr)
 {
-  ASSERT(sector <= (block_size (swap_block) - 8));
+  if (sector & ZSWAP_SECTOR)
+    {
+      zswap_load (sector & ~ZSWAP_SECTOR, kaddr);
+      return;
+    }
   ASSERT(is_kernel_vaddr (kaddr));
-  lock_acquire (&swap_table_lock);
-  ASSERT(bitmap_all (swap_bm, sector, 8));
-  for (int i = 0; i < 8; i++)
+  size_t dev = sector >> SWAP_DEVICE_SHIFT;
+  block_sector_t s = sector & SWAP_SECTOR_MASK;
+  ASSERT(dev < swap_device_cnt);
+  for (int i = 0; i < PAGE_SECTORS; i++)
     {
-      block_read (swap_block, sector + i, kaddr + (i * BLOCK_SECTOR_SIZE));
+      block_read (swap_devices[dev].block, s + i,
+		  kaddr + (i * BLOCK_SECTOR_SIZE));
     }
+  lock_acquire (&swap_table_lock);
   swap_free_internal (sector);
   lock_release (&swap_table_lock);
 }
@@ -74,7 +274,76 @@ swap_read (block_sector_t sector, void *kaddr)
 void
 swap_free (block_sector_t sector)
 {
+  if (sector & ZSWAP_SECTOR)
+    {
+      zswap_free (sector & ~ZSWAP_SECTOR);
+      return;
+    }
   lock_acquire (&swap_table_lock);
   swap_free_internal (sector);
   lock_release (&swap_table_lock);
 }
+
+/* Reserves room for PAGE_CNT pages of anonymous memory.  Returns false
+ if that would commit more than swap and user memory can hold and the
+ OOM policy does not allow overcommitting. */
+bool
+swap_reserve (size_t page_cnt)
+{
+  bool success = true;
+  lock_acquire (&swap_table_lock);
+  if (oom_policy == OOM_FAIL
+      && swap_committed_cnt + page_cnt
+	  > swap_slot_cnt + palloc_user_page_cnt ())
+    {
+      success = false;
+    }
+  else
+    {
+      swap_committed_cnt += page_cnt;
+    }
+  lock_release (&swap_table_lock);
+  return success;
+}
+
+/* Gives back a reservation made by swap_reserve(). */
+void
+swap_unreserve (size_t page_cnt)
+{
+  lock_acquire (&swap_table_lock);
+  ASSERT(swap_committed_cnt >= page_cnt);
+  swap_committed_cnt -= page_cnt;
+  lock_release (&swap_table_lock);
+}
+
+/* Returns true if every slot on every swap device is in use. */
+bool
+swap_full (void)
+{
+  return swap_used_cnt == swap_slot_cnt;
+}
+
+/* Stores the number of page slots in use on swap devices in *USED and
+ their total number in *TOTAL.  Pages in the compressed pool are not
+ counted. */
+void
+swap_usage (size_t *used, size_t *total)
+{
+  *used = swap_used_cnt;
+  *total = swap_slot_cnt;
+}
+
+void
+swap_print_stats (void)
+{
+  for (size_t i = 0; i < swap_device_cnt; i++)
+    {
+      struct swap_device *d = &swap_devices[i];
+      printf ("Swap %s: %zu of %zu pages in use, priority %d\n",
+	      block_name (d->block), bitmap_count (d->slots, 0,
+						   bitmap_size (d->slots),
+						   true),
+	      bitmap_size (d->slots), d->prio);
+    }
+  zswap_print_stats ();
+}
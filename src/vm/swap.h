@@ -10,8 +10,17 @@
 
 #include "devices/block.h"
 
+/* What to do when anonymous memory outgrows swap. */
+enum oom_policy
+{
+  OOM_FAIL, /* Refuse to reserve more than swap plus user memory */
+  OOM_KILL /* Reserve anything, kill the biggest process when swap is full */
+};
+
+extern enum oom_policy oom_policy;
+
 void
-swap_table_init (void);
+swap_table_init (char *names);
 
 block_sector_t
 swap_write (void *kaddr);
@@ -22,4 +31,19 @@ swap_read (block_sector_t sector, void *kaddr);
 void
 swap_free (block_sector_t sector);
 
+bool
+swap_reserve (size_t page_cnt);
+
+void
+swap_unreserve (size_t page_cnt);
+
+bool
+swap_full (void);
+
+void
+swap_usage (size_t *used, size_t *total);
+
+void
+swap_print_stats (void);
+
 #endif /* SRC_VM_SWAP_H_ */
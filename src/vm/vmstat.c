@@ -0,0 +1,41 @@
+/*
+ * vmstat.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Beshoy Saad
+ */
+
+#include "stdio.h"
+#include "swap.h"
+#include "vmstat.h"
+
+struct vmstat vm_stats;
+
+/* Copies the counters into STATS, along with the current swap usage. */
+void
+vmstat_get (struct vmstat *stats)
+{
+  size_t used, total;
+  swap_usage (&used, &total);
+  *stats = vm_stats;
+  stats->swap_used = used;
+  stats->swap_total = total;
+}
+
+void
+vmstat_print_stats (void)
+{
+  struct vmstat s;
+  vmstat_get (&s);
+  printf ("VM: %lld minor faults, %lld major faults, %lld stack growths\n",
+	  s.minor_faults, s.major_faults, s.stack_growths);
+  printf ("VM: %lld file, %lld swap, %lld zero fills, %lld cache hits\n",
+	  s.file_fills, s.swap_fills, s.zero_fills, s.cache_hits);
+  printf ("VM: %lld clean, %lld file, %lld swap evictions, "
+	  "%lld of them in the background\n",
+	  s.evict_clean, s.evict_file, s.evict_swap, s.evict_async);
+  printf ("VM: %lld writebacks, %lld clock scans\n", s.writebacks,
+	  s.clock_scans);
+  printf ("VM: %lld of %lld swap slots in use, %lld OOM kills\n",
+	  s.swap_used, s.swap_total, s.oom_kills);
+}
@@ -0,0 +1,26 @@
+/*
+ * vmstat.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Beshoy Saad
+ */
+
+#ifndef SRC_VM_VMSTAT_H_
+#define SRC_VM_VMSTAT_H_
+
+#include "lib/user/syscall.h"
+
+/* System wide counters, bumped in place by the code they describe.
+ Increments are single read-modify-write instructions, so they are
+ exact on our single CPU without any locking. */
+extern struct vmstat vm_stats;
+
+#define VMSTAT_INC(FIELD) (vm_stats.FIELD++)
+
+void
+vmstat_get (struct vmstat *stats);
+
+void
+vmstat_print_stats (void);
+
+#endif /* SRC_VM_VMSTAT_H_ */
@@ -0,0 +1,412 @@
+/*
+ * zswap.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Beshoy Saad
+ */
+
+#include "debug.h"
+#include "bitmap.h"
+#include "list.h"
+#include "stdio.h"
+#include "string.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "zswap.h"
+
+/* Compressed cache in front of the swap device.  Evicted pages are
+ compressed with a small LZF-style codec and kept in kernel memory;
+ only pages that do not compress well, or that find the pool full,
+ are written to disk.
+
+ Pool pages are shared zbud-style: each holds at most two compressed
+ pages, one packed against its start and one against its end, which
+ keeps the allocator trivial and frees a pool page as soon as both of
+ its halves are gone.  All-zero pages take no pool space at all. */
+
+/* Kernel pages the pool may take. */
+#define ZSWAP_POOL_PAGES 64
+
+/* Most pages the pool may hold, two per pool page. */
+#define ZSWAP_SLOTS (2 * ZSWAP_POOL_PAGES)
+
+/* Pages compressing to more than this are not worth keeping. */
+#define ZSWAP_MAX_SIZE (PGSIZE * 3 / 4)
+
+/* Pool page. */
+struct zpage
+{
+  struct list_elem elem; /* Element in unbuddied list, if it has room */
+  uint8_t *kaddr; /* Kernel page holding the data */
+  uint16_t first_size; /* Bytes used at the start, 0 if free */
+  uint16_t last_size; /* Bytes used at the end, 0 if free */
+};
+
+/* Compressed page. */
+struct zentry
+{
+  struct zpage *zp; /* Pool page holding it, NULL if all zeros */
+  uint16_t size; /* Compressed size */
+  bool last; /* Stored at the end of ZP rather than the start */
+};
+
+static struct zentry slots[ZSWAP_SLOTS];
+static struct bitmap *slot_map;
+static struct list unbuddied; /* Pool pages with a free half */
+static size_t pool_pages;
+static struct lock zswap_lock;
+
+/* Scratch space for compression, protected by zswap_lock. */
+static uint8_t zbuf[ZSWAP_MAX_SIZE];
+
+/* Statistics. */
+static unsigned long long stored_cnt; /* Pages kept in the pool */
+static unsigned long long zero_cnt; /* ...of which all zeros */
+static unsigned long long loaded_cnt; /* Disk reads avoided */
+static unsigned long long reject_cnt; /* Pages that did not compress */
+static unsigned long long full_cnt; /* Pages spilled to disk, pool full */
+static unsigned long long stored_bytes; /* Compressed size of stored pages */
+
+/* LZF-style codec.  The output is a sequence of literal runs, a
+ control byte below 32 followed by that many plus one bytes, and
+ back references: three bits of length (7 means an extra length
+ byte follows) and thirteen bits of offset. */
+
+#define LZ_HASH_BITS 12
+#define LZ_MAX_LIT 32
+#define LZ_MAX_OFF 8192
+#define LZ_MAX_REF (7 + 255 + 2)
+
+/* Last position each 3-byte sequence was seen at.  Entries left over
+ from earlier pages are harmless, since every match is verified. */
+static uint16_t lz_table[1 << LZ_HASH_BITS];
+
+static inline unsigned
+lz_hash (const uint8_t *p)
+{
+  uint32_t v = (p[0] << 16) | (p[1] << 8) | p[2];
+  return ((v * 2654435761u) >> (32 - LZ_HASH_BITS))
+      & ((1 << LZ_HASH_BITS) - 1);
+}
+
+/* Appends the LIT_CNT literals at LIT to OP, which must not pass
+ OUT_END.  Returns the new end of output, or NULL if it does not fit. */
+static uint8_t*
+lz_literals (uint8_t *op, uint8_t *out_end, const uint8_t *lit,
+	     size_t lit_cnt)
+{
+  while (lit_cnt > 0)
+    {
+      size_t n = lit_cnt < LZ_MAX_LIT ? lit_cnt : LZ_MAX_LIT;
+      if (op + 1 + n > out_end)
+	{
+	  return NULL;
+	}
+      *op++ = n - 1;
+      memcpy (op, lit, n);
+      op += n;
+      lit += n;
+      lit_cnt -= n;
+    }
+  return op;
+}
+
+/* Compresses IN_LEN bytes at IN into at most OUT_LEN bytes at OUT.
+ Returns the compressed size, or 0 if it does not fit. */
+static size_t
+lz_compress (const uint8_t *in, size_t in_len, uint8_t *out, size_t out_len)
+{
+  const uint8_t *ip = in;
+  const uint8_t *in_end = in + in_len;
+  const uint8_t *lit = in;
+  uint8_t *op = out;
+  uint8_t *out_end = out + out_len;
+
+  while (ip + 2 < in_end)
+    {
+      unsigned h = lz_hash (ip);
+      const uint8_t *ref = in + lz_table[h];
+      lz_table[h] = ip - in;
+      if (ref >= ip || ip - ref > LZ_MAX_OFF || ref[0] != ip[0]
+	  || ref[1] != ip[1] || ref[2] != ip[2])
+	{
+	  ip++;
+	  continue;
+	}
+
+      size_t max_len = in_end - ip < LZ_MAX_REF ? in_end - ip : LZ_MAX_REF;
+      size_t len = 3;
+      while (len < max_len && ref[len] == ip[len])
+	{
+	  len++;
+	}
+      op = lz_literals (op, out_end, lit, ip - lit);
+      if (op == NULL || op + 3 > out_end)
+	{
+	  return 0;
+	}
+      size_t off = ip - ref - 1;
+      if (len - 2 < 7)
+	{
+	  *op++ = (off >> 8) | ((len - 2) << 5);
+	}
+      else
+	{
+	  *op++ = (off >> 8) | (7 << 5);
+	  *op++ = len - 2 - 7;
+	}
+      *op++ = off & 0xff;
+      ip += len;
+      lit = ip;
+    }
+  op = lz_literals (op, out_end, lit, in_end - lit);
+  return op != NULL ? (size_t) (op - out) : 0;
+}
+
+/* Decompresses the IN_LEN bytes at IN into the OUT_LEN bytes at OUT,
+ which they must fill exactly. */
+static void
+lz_decompress (const uint8_t *in, size_t in_len, uint8_t *out,
+	       size_t out_len)
+{
+  const uint8_t *ip = in;
+  const uint8_t *in_end = in + in_len;
+  uint8_t *op = out;
+  uint8_t *out_end = out + out_len;
+
+  while (ip < in_end)
+    {
+      unsigned c = *ip++;
+      if (c < LZ_MAX_LIT)
+	{
+	  ASSERT(op + c + 1 <= out_end);
+	  memcpy (op, ip, c + 1);
+	  op += c + 1;
+	  ip += c + 1;
+	}
+      else
+	{
+	  size_t len = c >> 5;
+	  if (len == 7)
+	    {
+	      len += *ip++;
+	    }
+	  len += 2;
+	  const uint8_t *ref = op - ((c & 0x1f) << 8) - *ip++ - 1;
+	  ASSERT(ref >= out && op + len <= out_end);
+	  // The reference may overlap the output, copy byte by byte
+	  while (len-- > 0)
+	    {
+	      *op++ = *ref++;
+	    }
+	}
+    }
+  ASSERT(op == out_end);
+}
+
+void
+zswap_init (void)
+{
+  slot_map = bitmap_create (ZSWAP_SLOTS);
+  ASSERT(slot_map != NULL);
+  list_init (&unbuddied);
+  lock_init (&zswap_lock);
+}
+
+/* Returns true if the page at KADDR is all zeros. */
+static bool
+page_is_zero (const void *kaddr)
+{
+  const uint32_t *p = kaddr;
+  for (size_t i = 0; i < PGSIZE / sizeof *p; i++)
+    {
+      if (p[i] != 0)
+	{
+	  return false;
+	}
+    }
+  return true;
+}
+
+/* Finds room for SIZE bytes in the pool and stores E's location.
+ Returns false if the pool is full. */
+static bool
+zswap_place (struct zentry *e, size_t size)
+{
+  struct list_elem *le;
+  struct zpage *zp = NULL;
+  for (le = list_begin (&unbuddied); le != list_end (&unbuddied);
+      le = list_next (le))
+    {
+      struct zpage *cand = list_entry(le, struct zpage, elem);
+      if (cand->first_size + cand->last_size + size <= PGSIZE)
+	{
+	  zp = cand;
+	  list_remove (&zp->elem);
+	  break;
+	}
+    }
+  if (zp == NULL)
+    {
+      if (pool_pages >= ZSWAP_POOL_PAGES)
+	{
+	  return false;
+	}
+      zp = (struct zpage*) malloc (sizeof(struct zpage));
+      if (zp == NULL)
+	{
+	  return false;
+	}
+      zp->kaddr = palloc_get_page (0);
+      if (zp->kaddr == NULL)
+	{
+	  free (zp);
+	  return false;
+	}
+      zp->first_size = zp->last_size = 0;
+      pool_pages++;
+    }
+  e->zp = zp;
+  e->size = size;
+  if (zp->first_size == 0)
+    {
+      e->last = false;
+      zp->first_size = size;
+    }
+  else
+    {
+      e->last = true;
+      zp->last_size = size;
+    }
+  if (zp->first_size == 0 || zp->last_size == 0)
+    {
+      list_push_back (&unbuddied, &zp->elem);
+    }
+  return true;
+}
+
+/* Compresses the page at KADDR into the pool.  Returns its slot, or
+ BITMAP_ERROR if it belongs on disk instead. */
+size_t
+zswap_store (const void *kaddr)
+{
+  ASSERT(is_kernel_vaddr (kaddr));
+  lock_acquire (&zswap_lock);
+  size_t slot = bitmap_scan_and_flip (slot_map, 0, 1, false);
+  if (slot == BITMAP_ERROR)
+    {
+      full_cnt++;
+      lock_release (&zswap_lock);
+      return BITMAP_ERROR;
+    }
+  struct zentry *e = &slots[slot];
+  if (page_is_zero (kaddr))
+    {
+      e->zp = NULL;
+      e->size = 0;
+      zero_cnt++;
+    }
+  else
+    {
+      size_t size = lz_compress (kaddr, PGSIZE, zbuf, ZSWAP_MAX_SIZE);
+      if (size == 0 || !zswap_place (e, size))
+	{
+	  if (size == 0)
+	    {
+	      reject_cnt++;
+	    }
+	  else
+	    {
+	      full_cnt++;
+	    }
+	  bitmap_reset (slot_map, slot);
+	  lock_release (&zswap_lock);
+	  return BITMAP_ERROR;
+	}
+      memcpy (e->last ? e->zp->kaddr + PGSIZE - size : e->zp->kaddr, zbuf,
+	      size);
+    }
+  stored_cnt++;
+  stored_bytes += e->size;
+  lock_release (&zswap_lock);
+  return slot;
+}
+
+/* Releases the pool space of SLOT.  Must be called with zswap_lock
+ held. */
+static void
+zswap_release (size_t slot)
+{
+  ASSERT(slot < ZSWAP_SLOTS && bitmap_test (slot_map, slot));
+  struct zentry *e = &slots[slot];
+  struct zpage *zp = e->zp;
+  if (zp != NULL)
+    {
+      bool was_full = zp->first_size != 0 && zp->last_size != 0;
+      if (e->last)
+	{
+	  zp->last_size = 0;
+	}
+      else
+	{
+	  zp->first_size = 0;
+	}
+      if (zp->first_size == 0 && zp->last_size == 0)
+	{
+	  list_remove (&zp->elem);
+	  palloc_free_page (zp->kaddr);
+	  free (zp);
+	  pool_pages--;
+	}
+      else if (was_full)
+	{
+	  list_push_back (&unbuddied, &zp->elem);
+	}
+    }
+  bitmap_reset (slot_map, slot);
+}
+
+/* Decompresses SLOT into the page at KADDR and frees it. */
+void
+zswap_load (size_t slot, void *kaddr)
+{
+  ASSERT(is_kernel_vaddr (kaddr));
+  lock_acquire (&zswap_lock);
+  struct zentry *e = &slots[slot];
+  if (e->zp == NULL)
+    {
+      memset (kaddr, 0, PGSIZE);
+    }
+  else
+    {
+      const uint8_t *data =
+	  e->last ? e->zp->kaddr + PGSIZE - e->size : e->zp->kaddr;
+      lz_decompress (data, e->size, kaddr, PGSIZE);
+    }
+  loaded_cnt++;
+  zswap_release (slot);
+  lock_release (&zswap_lock);
+}
+
+void
+zswap_free (size_t slot)
+{
+  lock_acquire (&zswap_lock);
+  zswap_release (slot);
+  lock_release (&zswap_lock);
+}
+
+void
+zswap_print_stats (void)
+{
+  printf ("Zswap: %llu pages stored (%llu zero), %llu loaded, "
+	  "%llu incompressible, %llu spilled when full\n",
+	  stored_cnt, zero_cnt, loaded_cnt, reject_cnt, full_cnt);
+  if (stored_cnt > 0)
+    {
+      printf ("Zswap: %llu%% average compressed size, %zu pool pages in use\n",
+	      stored_bytes * 100 / (stored_cnt * PGSIZE), pool_pages);
+    }
+}
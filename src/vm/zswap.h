@@ -0,0 +1,28 @@
+/*
+ * zswap.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Beshoy Saad
+ */
+
+#ifndef SRC_VM_ZSWAP_H_
+#define SRC_VM_ZSWAP_H_
+
+#include <stddef.h>
+
+void
+zswap_init (void);
+
+size_t
+zswap_store (const void *kaddr);
+
+void
+zswap_load (size_t slot, void *kaddr);
+
+void
+zswap_free (size_t slot);
+
+void
+zswap_print_stats (void);
+
+#endif /* SRC_VM_ZSWAP_H_ */